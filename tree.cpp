@@ -2,13 +2,39 @@
  * Author(s): 1. Hanzala B. Rehan
  * Description: Function to read questions from a CSV file and parse them into Question objects with properly populated sets for positive and negative IDs.
  * Date created: November 27th, 2024
- * Date last modified: December 4th, 2024
+ * Date last modified: October 16th, 2026
 */
 /**
  * Changes Made:
  * Date         Author      Edit
  * 2024-11-27   1           Added structs for character, question. Utility Functions: parseSet, readQuestions, readCharacters. buildTree function.
  * 2024-12-04   1           Fixed csv and utility fuctions. Added game logic functions: getQuestion, getCharacter, setAnswer.
+ * 2026-10-16   1           Replaced set<int> character sets with the packed Bitset type; split scoring now uses popcount.
+ * 2026-10-16   1           buildTree: terminal empty sets, skips non-separating questions, memoizes subtrees by remaining set.
+ * 2026-10-16   1           QuestionTree is now immutable after construction; per-game state moved to the Session class.
+ * 2026-10-16   1           Replaced readCharacterByID with CharacterCatalog, loaded once per tree. getCharacter returns a pointer.
+ * 2026-10-16   1           readQuestionsFromCSV now parses a memory-mapped file in one pass (MappedFile, readCSVField).
+ * 2026-10-16   1           Tree nodes are compact TreeNodes allocated from a NodeArena and refer to the question bank by index.
+ * 2026-10-16   1           The built tree is flattened breadth-first into a FlatNode array; Session keeps a node index.
+ * 2026-10-16   1           Trees are stored as a binary snapshot image that can be saved and mmap-loaded; added TreeBuilder.
+ * 2026-10-16   1           setAnswer removes ruled-out characters in place (Bitset::subtract) without allocating.
+ * 2026-10-16   1           buildTree tracks asked questions in a path bitmask instead of copying candidate vectors.
+ * 2026-10-16   1           Added SplitCriterion scorers (balance, information gain, Gini, expected remaining) via BuildOptions.
+ * 2026-10-16   1           Parallel tree builds on a work-stealing TaskPool (BuildOptions::threads).
+ * 2026-10-16   1           Added AnswerMatrix (yes/no bit-planes by question and by character), shared by every engine.
+ * 2026-10-16   1           Added readDataCSV to load data.csv directly, replacing the dataHandling.ipynb step.
+ * 2026-10-16   1           Optional optimal tree search (minimum expected or worst-case depth) with branch and bound.
+ * 2026-10-16   1           QuestionTree::addCharacter inserts a character by rebuilding only the leaf it reaches.
+ * 2026-10-16   1           QuestionTree::addQuestion rebuilds only the subtrees the new question improves.
+ * 2026-10-16   1           Lazy build mode: nodes are built and cached the first time a game reaches them.
+ * 2026-10-16   1           UNKNOWN answers follow both branches when building, matching Session's candidate set.
+ * 2026-10-16   1           Characters come from characters.csv and are stored by dense index; IDs are mapped back on output.
+ * 2026-10-16   1           BayesianSession: probabilistic game that tolerates wrong answers.
+ * 2026-10-16   1           BayesianSession can pick each question by expected information gain instead of following the tree.
+ * 2026-10-16   1           Graded answers (yes, probably, don't know, probably not, no) for both kinds of session.
+ * 2026-10-16   1           FeedbackLog: answers from finished games correct the answer matrix for the next rebuild.
+ * 2026-10-16   1           getCandidates: the k most likely characters and their probabilities, at any point of a game.
+ * 2026-10-16   1           Snapshots keep question IDs, so banks copied out of a tree keep the CSV's IDs.
 */
 
 // All necessary imports.
@@ -17,312 +43,3412 @@
 #include <sstream>
 #include <string>
 #include <vector>
-#include <set>
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <cstring>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 using namespace std;
 
-struct Character
+class Bitset
 {
 public:
-    int char_id;        // Unique character ID
-    string name;        // Character Name.
-    string image_path;  // Image path for this character.
+    vector<uint64_t> words; // Packed membership bits, 64 IDs per word.
 
-    Character(int id, const string &n, const string &img)
-        : char_id(id), name(n), image_path(img) {}
-};
+    // Constructors
+    Bitset() {}
+    Bitset(const uint64_t *data, size_t count) : words(data, data + count) {}
 
-Character readCharacterByID(const string &filename, int search_id)
-{
-    /*
-    Desc: Opens a file and reads its contents line by line to find a character with the specified ID.
-    returns:
-    (Character): A Character object containing the ID, name, and image path.
-    Parameters:
-        filename (const string &): The path to the file to be read.
-        search_id (int): The ID of the character to search for in the file.
-    */
-    ifstream file(filename);
+    void insert(int id)
+    {
+        /*
+        Desc: Adds an ID to the set, growing the word array if needed.
+        Parameters:
+            id (int): The non-negative ID to add.
+        */
+        size_t word = (size_t)id >> 6;
+        if (word >= words.size())
+        {
+            words.resize(word + 1, 0);
+        }
+        words[word] |= uint64_t(1) << (id & 63);
+    }
 
-    if (!file.is_open())
+    void erase(int id)
     {
-        cerr << "Error: Unable to open file " << filename << endl;
-        throw runtime_error("File not found");
+        size_t word = (size_t)id >> 6;
+        if (word < words.size())
+        {
+            words[word] &= ~(uint64_t(1) << (id & 63));
+        }
     }
 
-    string line;
-    bool firstLine = true;
+    bool contains(int id) const
+    {
+        size_t word = (size_t)id >> 6;
+        return word < words.size() && ((words[word] >> (id & 63)) & 1);
+    }
 
-    // Read file line by line
-    while (getline(file, line))
+    size_t size() const
     {
-        if (firstLine)
+        /*
+        Desc: Counts the IDs in the set.
+        returns:
+        (size_t): Number of set bits.
+        */
+        size_t total = 0;
+        for (uint64_t w : words)
         {
-            firstLine = false; // Skip the header
-            continue;
+            total += __builtin_popcountll(w);
+        }
+        return total;
+    }
+
+    bool empty() const
+    {
+        for (uint64_t w : words)
+        {
+            if (w)
+            {
+                return false;
+            }
         }
+        return true;
+    }
 
-        istringstream stream(line);
-        string id_str, name, image_path;
+    int first() const
+    {
+        /*
+        Desc: Finds the smallest ID in the set.
+        returns:
+        (int): The smallest ID, or -1 if the set is empty.
+        */
+        for (size_t i = 0; i < words.size(); i++)
+        {
+            if (words[i])
+            {
+                return (int)(i * 64 + __builtin_ctzll(words[i]));
+            }
+        }
+        return -1;
+    }
 
-        // Read fields separated by commas
-        getline(stream, id_str, ',');
-        getline(stream, name, ',');
-        getline(stream, image_path, ',');
+    Bitset intersection(const uint64_t *mask, size_t count) const
+    {
+        /*
+        Desc: Builds the set of IDs present both here and in a raw word array.
+        returns:
+        (Bitset): The intersection.
+        Parameters:
+            mask (const uint64_t *): The other set, packed like words.
+            count (size_t): Number of words in mask.
+        */
+        Bitset result;
+        size_t n = min(words.size(), count);
+        result.words.resize(n);
+        for (size_t i = 0; i < n; i++)
+        {
+            result.words[i] = words[i] & mask[i];
+        }
+        return result;
+    }
 
-        // Convert ID to integer
-        int id = stoi(id_str);
+    Bitset intersection(const Bitset &other) const
+    {
+        return intersection(other.words.data(), other.words.size());
+    }
 
-        // Check if this is the desired ID
-        if (id == search_id)
+    void subtract(const uint64_t *mask, size_t count)
+    {
+        /*
+        Desc: Removes, in place, every ID whose bit is set in a raw word array.
+        Parameters:
+            mask (const uint64_t *): The IDs to remove, packed like words.
+            count (size_t): Number of words in mask.
+        */
+        size_t n = min(words.size(), count);
+        for (size_t i = 0; i < n; i++)
         {
-            file.close();
-            return Character(id, name, image_path);
+            words[i] &= ~mask[i];
         }
     }
 
-    file.close();
-    throw runtime_error("Character with the given ID not found");
-}
+    bool operator==(const Bitset &other) const
+    {
+        // Trailing zero words do not change membership, so compare up to the longer array.
+        size_t n = max(words.size(), other.words.size());
+        for (size_t i = 0; i < n; i++)
+        {
+            uint64_t a = i < words.size() ? words[i] : 0;
+            uint64_t b = i < other.words.size() ? other.words[i] : 0;
+            if (a != b)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
 
-class Question
+    size_t fingerprint() const
+    {
+        /*
+        Desc: Hashes the set contents (FNV-1a over the words, ignoring trailing zero words).
+        returns:
+        (size_t): A hash consistent with operator==.
+        */
+        size_t n = words.size();
+        while (n > 0 && words[n - 1] == 0)
+        {
+            n--;
+        }
+        uint64_t hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < n; i++)
+        {
+            hash = (hash ^ words[i]) * 1099511628211ULL;
+        }
+        return (size_t)hash;
+    }
+};
+
+struct BitsetHash
 {
-public:
-    int q_id;                  // Unique question ID
-    string text;               // Question text
-    set<int> positive_ids;     // Characters for "yes" answers
-    set<int> negative_ids;     // Characters for "no" answers
-    Question *left = nullptr;  // Pointer to the "yes" subtree
-    Question *right = nullptr; // Pointer to the "no" subtree
+    size_t operator()(const Bitset &b) const { return b.fingerprint(); }
+};
 
+// Read-only memory mapping of a whole file; unmapped when destroyed. An empty file cannot be mapped, so it
+// opens with an empty view.
+class MappedFile
+{
+private:
+    const char *bytes = nullptr;   // Start of the mapping, nullptr if the file is empty or could not be mapped
+    size_t length = 0;             // Size of the file in bytes
+    bool opened = false;           // Whether the file was opened and, unless empty, mapped
+
+public:
     // Constructor
-    Question(int id, string txt, set<int> pos_ids, set<int> neg_ids)
-        : q_id(id), text(txt), positive_ids(pos_ids), negative_ids(neg_ids) {}
+    MappedFile(const string &filename)
+    {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return;
+        }
+        struct stat info;
+        if (fstat(fd, &info) == 0)
+        {
+            if (info.st_size == 0)
+            {
+                opened = true;
+            }
+            else
+            {
+                void *mapped = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped != MAP_FAILED)
+                {
+                    bytes = (const char *)mapped;
+                    length = (size_t)info.st_size;
+                    opened = true;
+                }
+            }
+        }
+        close(fd); // The mapping stays valid after the descriptor is closed.
+    }
+
+    ~MappedFile()
+    {
+        if (bytes)
+        {
+            munmap((void *)bytes, length);
+        }
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool is_open() const { return opened; }
+    bool empty() const { return length == 0; }
+    string_view view() const { return string_view(bytes, length); }
 };
 
-set<int> parseSet(const string &setStr)
+uint64_t checksumFiles(initializer_list<string> filenames)
 {
     /*
-    Desc: Parses a set of integers from a string representation.
+    Desc: Computes an FNV-1a checksum over the contents of several files, used to tell whether a snapshot was
+          built from the current data. Missing files hash as empty.
     returns:
-    (set<int>): A set of integers parsed from the string.
+    (uint64_t): The combined checksum.
     Parameters:
-        setStr (const string &): A string representing a set of integers enclosed in curly braces (e.g., "{1.2.3}").
+        filenames (initializer_list<string>): The files to hash, in order.
     */
-    set<int> result;
-    string numbers = setStr.substr(1, setStr.size() - 2); // Remove { and }
-    stringstream ss(numbers);
-    string item;
-    while (getline(ss, item, '.'))
+    uint64_t hash = 14695981039346656037ULL;
+    for (const string &filename : filenames)
     {
-        result.insert(stoi(item));
+        MappedFile file(filename);
+        for (char c : file.view())
+        {
+            hash = (hash ^ (unsigned char)c) * 1099511628211ULL;
+        }
+        hash = (hash ^ 0xFF) * 1099511628211ULL; // File separator
     }
-    return result;
+    return hash;
 }
 
-vector<Question *> readQuestionsFromCSV(const string &filename)
+string_view readCSVField(string_view buffer, size_t &pos, bool &quoted)
 {
     /*
-    Desc: Reads questions from a CSV file and stores them as Question objects.
+    Desc: Splits the next comma-separated field off a CSV buffer without copying it. Stops at the end of the line,
+          which is left for skipCSVLine to consume.
     returns:
-    (vector<Question *>): A vector of pointers to Question objects.
+    (string_view): The raw field. For quoted fields the surrounding quotes are removed but doubled quotes ("") are
+                   kept; see unquoteCSV.
     Parameters:
-        filename (const string &): The path to the CSV file containing questions data.
+        buffer (string_view): The whole CSV file contents.
+        pos (size_t &): Offset of the field's first character; advanced past the field and its comma.
+        quoted (bool &): Set to whether the field was enclosed in double quotes.
     */
-    vector<Question *> questions;
-    ifstream file(filename);
+    size_t start = pos;
+    size_t end;
+    quoted = pos < buffer.size() && buffer[pos] == '"';
 
-    if (!file.is_open())
+    if (quoted)
     {
-        cerr << "Error opening file: " << filename << endl;
-        return questions;
+        start = ++pos;
+        while (pos < buffer.size())
+        {
+            if (buffer[pos] == '"')
+            {
+                if (pos + 1 < buffer.size() && buffer[pos + 1] == '"')
+                {
+                    pos += 2; // Escaped quote inside the field
+                    continue;
+                }
+                break;
+            }
+            pos++;
+        }
+        end = pos;
+        if (pos < buffer.size())
+        {
+            pos++; // Closing quote
+        }
+    }
+    else
+    {
+        while (pos < buffer.size() && buffer[pos] != ',' && buffer[pos] != '\r' && buffer[pos] != '\n')
+        {
+            pos++;
+        }
+        end = pos;
     }
 
-    string line;
-    getline(file, line); // Skip header line
-
-    while (getline(file, line))
+    if (pos < buffer.size() && buffer[pos] == ',')
     {
-        stringstream ss(line);
-        string idStr, text, trueSetStr, falseSetStr;
+        pos++;
+    }
+    return buffer.substr(start, end - start);
+}
 
-        // Read fields separated by commas
-        getline(ss, idStr, ',');
-        getline(ss, text, ',');
-        getline(ss, trueSetStr, ',');
-        getline(ss, falseSetStr, ',');
+void skipCSVLine(string_view buffer, size_t &pos)
+{
+    /*
+    Desc: Advances past the rest of the current line, including its \n or \r\n terminator.
+    Parameters:
+        buffer (string_view): The whole CSV file contents.
+        pos (size_t &): Current offset; moved to the start of the next line.
+    */
+    size_t newline = buffer.find('\n', pos);
+    pos = newline == string_view::npos ? buffer.size() : newline + 1;
+}
 
-        // Remove extra quotes from the question text
-        if (text.front() == '"' && text.back() == '"')
+string unquoteCSV(string_view field)
+{
+    /*
+    Desc: Turns the body of a quoted CSV field into its text by collapsing each doubled quote ("") into one.
+    returns:
+    (string): The unescaped text.
+    Parameters:
+        field (string_view): The field contents between the enclosing quotes.
+    */
+    string text;
+    text.reserve(field.size());
+    for (size_t i = 0; i < field.size(); i++)
+    {
+        text += field[i];
+        if (field[i] == '"' && i + 1 < field.size() && field[i + 1] == '"')
         {
-            text = text.substr(1, text.size() - 2);
+            i++;
         }
-
-        // Parse fields
-        int id = stoi(idStr);
-        set<int> trueSet = parseSet(trueSetStr);
-        set<int> falseSet = parseSet(falseSetStr);
-
-        // Create and store Question object
-        questions.push_back(new Question(id, text, trueSet, falseSet));
     }
+    return text;
+}
 
-    file.close();
-    return questions;
+int parseInt(string_view digits, size_t &pos)
+{
+    /*
+    Desc: Reads a non-negative decimal integer starting at pos, without allocating.
+    returns:
+    (int): The value, or -1 if there is no digit at pos.
+    Parameters:
+        digits (string_view): The text to read from.
+        pos (size_t &): Offset of the first digit; advanced past the last one.
+    */
+    if (pos >= digits.size() || digits[pos] < '0' || digits[pos] > '9')
+    {
+        return -1;
+    }
+    int value = 0;
+    while (pos < digits.size() && digits[pos] >= '0' && digits[pos] <= '9')
+    {
+        value = value * 10 + (digits[pos] - '0');
+        pos++;
+    }
+    return value;
 }
 
-class QuestionTree
+struct Character
 {
-private:
-    Question *root;                                     // Root of the question tree
-    const string charactersFilename = "characters.csv";  // Filename for the characters csv.
-    set<int> characters = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
-                            17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29,
-                            30, 31, 32};                // Set for IDs of all characters.
+public:
+    int char_id;        // Unique character ID
+    string name;        // Character Name.
+    string image_path;  // Image path for this character.
+
+    Character() : char_id(-1) {}
+    Character(int id, const string &n, const string &img)
+        : char_id(id), name(n), image_path(img) {}
+};
 
+// All characters, loaded once. Each character gets a dense index, in order of addition, that the answer matrix
+// and the tree use in place of its ID, so IDs may be sparse or large.
+class CharacterCatalog
+{
+private:
+    vector<Character> characters;       // Characters by index
+    unordered_map<int, int> indices;    // Index of each character ID
 
-    // Constructor
-    QuestionTree(string filename){
-        vector<Question *> questions = readQuestionsFromCSV(filename);
-        root = buildTree(characters, questions);
-    }
-    
-    Question* buildTree(set<int> remaining_ids, vector<Question *> &questions)
+public:
+    // Constructors
+    CharacterCatalog() {}
+    CharacterCatalog(const string &filename)
     {
         /*
-        Desc: Recursively builds a decision tree by selecting questions that best split the set of remaining character IDs.
-        returns:
-        (Question*): A pointer to the root of the decision tree.
+        Desc: Reads every character from the CSV file, indexing them in file order.
         Parameters:
-            remaining_ids (set<int>): The set of character IDs that need to be distinguished.
-            questions (vector<Question *> &): A vector of available questions to use for splitting.
+            filename (const string &): The path to the characters CSV file.
         */
-        if (remaining_ids.size() == 1)
-        {
-            // Terminal condition: only one character left
-            return new Question(-1, "Character identified: " + to_string(*remaining_ids.begin()), {}, {});
-        }
+        ifstream file(filename);
 
-        if (questions.empty())
+        if (!file.is_open())
         {
-            // Terminal condition: no more questions
-            return new Question(-1, "No more questions. Unable to identify.", {}, {});
+            cerr << "Error: Unable to open file " << filename << endl;
+            throw runtime_error("File not found");
         }
 
-        // Select the best question (most balanced split)
-        Question *best_question = nullptr;
-        int min_difference = INT_MAX;
+        string line;
+        getline(file, line); // Skip the header
 
-        for (auto *q : questions)
+        // Read file line by line
+        while (getline(file, line))
         {
-            set<int> pos_ids;
-            set<int> neg_ids;
+            istringstream stream(line);
+            string id_str, name, image_path;
 
-            // Intersection of the question's IDs with remaining IDs
-            set_intersection(remaining_ids.begin(), remaining_ids.end(),
-                                q->positive_ids.begin(), q->positive_ids.end(),
-                                inserter(pos_ids, pos_ids.begin()));
-            set_intersection(remaining_ids.begin(), remaining_ids.end(),
-                                q->negative_ids.begin(), q->negative_ids.end(),
-                                inserter(neg_ids, neg_ids.begin()));
+            // Read fields separated by commas
+            getline(stream, id_str, ',');
+            getline(stream, name, ',');
+            getline(stream, image_path, ',');
 
-            int difference = abs((int)pos_ids.size() - (int)neg_ids.size());
-            if (difference < min_difference)
-            {
-                min_difference = difference;
-                best_question = q;
-            }
+            add(Character(stoi(id_str), name, image_path));
         }
 
-        if (!best_question)
+        file.close();
+    }
+
+    int add(const Character &character)
+    {
+        /*
+        Desc: Stores a character under the next index, or replaces the character with the same ID.
+        returns:
+        (int): The character's index.
+        Parameters:
+            character (const Character &): The character to store.
+        */
+        auto known = indices.emplace(character.char_id, (int)characters.size());
+        if (known.second)
         {
-            // No suitable question found
-            return new Question(-1, "Unable to further differentiate.", {}, {});
+            characters.push_back(character);
         }
+        else
+        {
+            characters[known.first->second] = character;
+        }
+        return known.first->second;
+    }
 
-        // Partition remaining IDs
-        set<int> pos_ids;
-        set<int> neg_ids;
+    bool contains(int id) const { return indices.count(id) > 0; }
 
-        set_intersection(remaining_ids.begin(), remaining_ids.end(),
-                            best_question->positive_ids.begin(), best_question->positive_ids.end(),
-                            inserter(pos_ids, pos_ids.begin()));
-        set_intersection(remaining_ids.begin(), remaining_ids.end(),
-                            best_question->negative_ids.begin(), best_question->negative_ids.end(),
-                            inserter(neg_ids, neg_ids.begin()));
+    int indexOf(int id) const
+    {
+        /*
+        Desc: Maps a character ID to its dense index.
+        returns:
+        (int): The index, or -1 if no character has the ID.
+        Parameters:
+            id (int): A character ID.
+        */
+        auto known = indices.find(id);
+        return known == indices.end() ? -1 : known->second;
+    }
 
-        // Remove the chosen question from the list
-        vector<Question *> remaining_questions;
-        for (auto *q : questions)
+    const Character &at(int index) const { return characters[index]; }
+
+    const Character &get(int id) const
+    {
+        /*
+        Desc: Looks up a character by ID without touching the file.
+        returns:
+        (const Character &): The character with the given ID.
+        Parameters:
+            id (int): The ID of the character to look up.
+        */
+        int index = indexOf(id);
+        if (index < 0)
         {
-            if (q != best_question)
-            {
-                remaining_questions.push_back(q);
-            }
+            throw runtime_error("Character with the given ID not found");
         }
+        return characters[index];
+    }
 
-        // Recursively build subtrees
-        Question *node = new Question(best_question->q_id, best_question->text,
-                                        best_question->positive_ids, best_question->negative_ids);
-        node->left = buildTree(pos_ids, remaining_questions);  // "yes" branch
-        node->right = buildTree(neg_ids, remaining_questions); // "no" branch
-
-        return node;
+    const Character &notFound() const
+    {
+        /*
+        Desc: Gives the entry shown when no character matches the answers: ID 0 if the catalog has one,
+              otherwise a built-in stand-in with ID 0 and no image.
+        returns:
+        (const Character &): The "no character found" entry.
+        */
+        static const Character fallback(0, "Sorry! No Character Found.", "");
+        int index = indexOf(0);
+        return index < 0 ? fallback : characters[index];
     }
 
+    size_t size() const { return characters.size(); }
+};
+
+class Question
+{
+public:
+    int q_id;                  // Unique question ID
+    string text;               // Question text
+
+    // Constructor
+    Question(int id, string txt)
+        : q_id(id), text(txt) {}
+};
+
+// What the data says about one character for one question.
+enum Membership
+{
+    UNKNOWN = 0,    // In neither of the question's sets
+    POSITIVE = 1,   // Answers "yes"
+    NEGATIVE = 2    // Answers "no"
+};
+
+// Every character's answer to every question, stored as packed bit-planes in both orientations: by question
+// (the characters answering "yes", then those answering "no") and by character (the questions it answers
+// "yes", then "no"). A pair in neither plane is UNKNOWN. The matrix either owns its planes or views planes
+// stored elsewhere, such as in a mapped snapshot.
+class AnswerMatrix
+{
+private:
+    vector<uint64_t> storage;                // Both orientations, when the matrix owns its planes
+    const uint64_t *by_question = nullptr;   // [question][POSITIVE, NEGATIVE][character_words]
+    const uint64_t *by_character = nullptr;  // [character][POSITIVE, NEGATIVE][question_words]
+    size_t question_count = 0;               // Questions in the bank
+    size_t character_words = 0;              // Words per row of characters; character indices go up to 64 * this
+    size_t question_words = 0;               // Words per row of questions
+
 public:
-    string getQuestionText() {
+    // Constructors
+    AnswerMatrix() {}
+    AnswerMatrix(size_t questions, size_t characters)
+        : question_count(questions), character_words((characters + 63) / 64), question_words((questions + 63) / 64)
+    {
         /*
-        Desc: Retrieves the text of the current question.
-        returns:
-        (string): The text content of the current question.
+        Desc: Creates an owned matrix with every answer UNKNOWN.
+        Parameters:
+            questions (size_t): Number of questions.
+            characters (size_t): Number of character slots (largest character index + 1).
         */
-        return root->text;
+        storage.assign(question_count * 2 * character_words + character_words * 64 * 2 * question_words, 0);
+        by_question = storage.data();
+        by_character = storage.data() + question_count * 2 * character_words;
     }
+    AnswerMatrix(const uint64_t *questionPlanes, const uint64_t *characterPlanes, size_t questions, size_t words)
+        : by_question(questionPlanes), by_character(characterPlanes), question_count(questions),
+          character_words(words), question_words((questions + 63) / 64) {}
 
-    Character getCharacter() {
+    // Views point into storage, which moves with the vector, so only copies are a problem.
+    AnswerMatrix(const AnswerMatrix &) = delete;
+    AnswerMatrix &operator=(const AnswerMatrix &) = delete;
+    AnswerMatrix(AnswerMatrix &&) = default;
+    AnswerMatrix &operator=(AnswerMatrix &&) = default;
+
+    void set(int character, int question, Membership value)
+    {
         /*
-        Desc: Retrieves a character based on the current state of the characters set.
-        returns:
-        (Character): A Character if game is over, null otherwise.
+        Desc: Records one answer in both orientations. Only valid for matrices that own their planes.
+        Parameters:
+            character (int): Character index.
+            question (int): Question index.
+            value (Membership): The answer.
         */
-        if (characters.size() > 1) {
-            return;
+        uint64_t *question_row = storage.data() + (size_t)question * 2 * character_words;
+        uint64_t *character_row = storage.data() + question_count * 2 * character_words +
+                                  (size_t)character * 2 * question_words;
+        uint64_t character_bit = uint64_t(1) << (character & 63);
+        uint64_t question_bit = uint64_t(1) << (question & 63);
+        for (int plane = 0; plane < 2; plane++)
+        {
+            bool on = value == (plane == 0 ? POSITIVE : NEGATIVE);
+            uint64_t &by_q = question_row[plane * character_words + (character >> 6)];
+            uint64_t &by_c = character_row[plane * question_words + (question >> 6)];
+            by_q = on ? (by_q | character_bit) : (by_q & ~character_bit);
+            by_c = on ? (by_c | question_bit) : (by_c & ~question_bit);
         }
-        else if (characters.size() < 1) {
-            return readCharacterByID(charactersFilename, 0);
+    }
+
+    Membership get(int character, int question) const
+    {
+        const uint64_t *row = by_character + (size_t)character * 2 * question_words;
+        if ((row[question >> 6] >> (question & 63)) & 1)
+        {
+            return POSITIVE;
         }
-        else {
-            int characterID = *characters.begin();
-            return readCharacterByID(charactersFilename, characterID);
+        if ((row[question_words + (question >> 6)] >> (question & 63)) & 1)
+        {
+            return NEGATIVE;
         }
+        return UNKNOWN;
     }
 
-    void setAnswer(bool Answer){
+    const uint64_t *characters(int question, Membership value) const
+    {
         /*
-        Desc: Updates the set of characters based on the answer provided and navigates the decision tree accordingly.
+        Desc: Gives the characters with a given answer to a question.
+        returns:
+        (const uint64_t *): characterWords() words of character bits.
         Parameters:
-            Answer (bool): The answer to the current question, where 'true' or 'false' affects character selection.
+            question (int): Question index.
+            value (Membership): POSITIVE or NEGATIVE.
         */
-        if (Answer) {
-            // Creating a temporary set for the difference of characters set and negative ids.
-            set<int> diff;
-            set_difference(characters.begin(), characters.end(),
-                        root->negative_ids.begin(), root->negative_ids.end(),
-                        inserter(diff, diff.begin()));
-            
-            characters = diff;
-            root = root->left;
-        }
-        else {
-            // Creating a temporary set for the difference of characters set and positive ids.
-            set<int> diff;
-            set_difference(characters.begin(), characters.end(),
-                        root->positive_ids.begin(), root->positive_ids.end(),
-                        inserter(diff, diff.begin()));
-            
-            characters = diff;
-            root = root->right;
-        }
+        return by_question + ((size_t)question * 2 + (value == POSITIVE ? 0 : 1)) * character_words;
+    }
+
+    Bitset branch(const Bitset &remaining, int question, bool answer) const
+    {
+        /*
+        Desc: Narrows a set of characters by an answer. Only the characters who gave the opposite answer are
+              ruled out; those whose answer is UNKNOWN stay possible on both branches.
+        returns:
+        (Bitset): The characters still possible after the answer.
+        Parameters:
+            remaining (const Bitset &): The characters possible before the answer.
+            question (int): Question index.
+            answer (bool): True for "yes".
+        */
+        Bitset result = remaining;
+        result.subtract(characters(question, answer ? NEGATIVE : POSITIVE), character_words);
+        return result;
+    }
+
+    const uint64_t *questions(int character, Membership value) const
+    {
+        /*
+        Desc: Gives the questions a character answers a given way.
+        returns:
+        (const uint64_t *): questionWords() words of question bits.
+        Parameters:
+            character (int): Character index.
+            value (Membership): POSITIVE or NEGATIVE.
+        */
+        return by_character + ((size_t)character * 2 + (value == POSITIVE ? 0 : 1)) * question_words;
+    }
+
+    size_t questionCount() const { return question_count; }
+    size_t characterWords() const { return character_words; }
+    size_t characterSlots() const { return character_words * 64; }
+    size_t questionWords() const { return question_words; }
+    const uint64_t *questionPlanes() const { return by_question; }
+    const uint64_t *characterPlanes() const { return by_character; }
+    size_t questionPlanesSize() const { return question_count * 2 * character_words; }
+    size_t characterPlanesSize() const { return character_words * 64 * 2 * question_words; }
+};
+
+// The parsed contents of questions.csv.
+struct QuestionBank
+{
+    vector<Question> questions;     // ID and text of each question, in file order
+    AnswerMatrix answers;           // Which characters answer each question "yes" or "no"
+};
+
+void parseSet(string_view setStr, const CharacterCatalog &catalog, AnswerMatrix &answers, int question,
+              Membership value)
+{
+    /*
+    Desc: Parses a set of character IDs from a string representation straight into the answer matrix, at the
+          characters' catalog indices. IDs that are not in the catalog are ignored.
+    Parameters:
+        setStr (string_view): A string representing a set of integers enclosed in curly braces (e.g., "{1.2.3}").
+        catalog (const CharacterCatalog &): Maps the IDs to indices.
+        answers (AnswerMatrix &): The matrix to fill; must have a slot for every catalog index.
+        question (int): Index of the question the set belongs to.
+        value (Membership): The answer of every character in the set.
+    */
+    size_t pos = 0;
+    while (pos < setStr.size())
+    {
+        int id = parseInt(setStr, pos);
+        if (id < 0)
+        {
+            pos++; // Skip '{', '.' and '}'
+            continue;
+        }
+        int index = catalog.indexOf(id);
+        if (index >= 0)
+        {
+            answers.set(index, question, value);
+        }
+    }
+}
+
+QuestionBank readQuestionsFromCSV(const string &filename, const CharacterCatalog &catalog)
+{
+    /*
+    Desc: Reads questions from a CSV file into Question objects and an answer matrix. The file is memory-mapped;
+          one pass splits the fields, and the ID lists are then decoded straight into the matrix at the
+          characters' catalog indices. Only the question text is copied out of the file.
+    returns:
+    (QuestionBank): The questions, in file order, and their answers.
+    Parameters:
+        filename (const string &): The path to the CSV file containing questions data.
+        catalog (const CharacterCatalog &): Every character the sets may refer to.
+    */
+    QuestionBank bank;
+    MappedFile file(filename);
+
+    if (!file.is_open())
+    {
+        cerr << "Error opening file: " << filename << endl;
+        return bank;
+    }
+    if (file.empty())
+    {
+        cerr << "Error: file is empty: " << filename << endl;
+        return bank;
+    }
+
+    string_view buffer = file.view();
+    size_t pos = 0;
+    skipCSVLine(buffer, pos); // Skip header line
+
+    vector<pair<string_view, string_view>> sets; // "yes" and "no" set text of each question
+    while (pos < buffer.size())
+    {
+        bool quoted;
+
+        // Read fields separated by commas
+        string_view idStr = readCSVField(buffer, pos, quoted);
+        string_view textStr = readCSVField(buffer, pos, quoted);
+        bool textQuoted = quoted;
+        string_view trueSetStr = readCSVField(buffer, pos, quoted);
+        string_view falseSetStr = readCSVField(buffer, pos, quoted);
+        skipCSVLine(buffer, pos);
+
+        // Parse fields
+        size_t digit = 0;
+        int id = parseInt(idStr, digit);
+        if (id < 0)
+        {
+            continue; // Blank or malformed line
+        }
+        string text = textQuoted ? unquoteCSV(textStr) : string(textStr);
+
+        // Create and store Question object
+        bank.questions.emplace_back(id, text);
+        sets.emplace_back(trueSetStr, falseSetStr);
+    }
+
+    bank.answers = AnswerMatrix(bank.questions.size(), catalog.size());
+    for (size_t q = 0; q < sets.size(); q++)
+    {
+        parseSet(sets[q].first, catalog, bank.answers, (int)q, POSITIVE);
+        parseSet(sets[q].second, catalog, bank.answers, (int)q, NEGATIVE);
+    }
+    return bank;
+}
+
+QuestionBank readDataCSV(const string &filename, CharacterCatalog &catalog)
+{
+    /*
+    Desc: Reads the raw 0/1 matrix from data.csv (one row per character, one column per question) straight into
+          a question bank and character catalog, deriving everything the way dataHandling.ipynb did: characters
+          are numbered from 1 in row order with image path characters_img/<name>.webp, question IDs are column
+          numbers (the Character column is 1, so the first question is 2), and commas are removed from question
+          text. A 1 is a "yes", a 0 a "no", anything else is left unknown. Character 0 is added as the
+          "no character found" entry that characters.csv carries.
+    returns:
+    (QuestionBank): The questions, in column order, and their answers.
+    Parameters:
+        filename (const string &): The path to data.csv.
+        catalog (CharacterCatalog &): Receives one character per row.
+    */
+    QuestionBank bank;
+    MappedFile file(filename);
+
+    if (!file.is_open())
+    {
+        cerr << "Error opening file: " << filename << endl;
+        return bank;
+    }
+    if (file.empty())
+    {
+        cerr << "Error: file is empty: " << filename << endl;
+        return bank;
+    }
+
+    string_view buffer = file.view();
+    size_t pos = 0;
+    bool quoted;
+
+    // Header: the Character column, then one column per question
+    readCSVField(buffer, pos, quoted);
+    int column = 1;
+    while (pos < buffer.size() && buffer[pos] != '\r' && buffer[pos] != '\n')
+    {
+        string_view textStr = readCSVField(buffer, pos, quoted);
+        string text = quoted ? unquoteCSV(textStr) : string(textStr);
+        text.erase(remove(text.begin(), text.end(), ','), text.end());
+        bank.questions.emplace_back(++column, text);
+    }
+    skipCSVLine(buffer, pos);
+
+    // Every remaining line is at most one character, which bounds the indices before the rows are read.
+    size_t rows = count(buffer.begin() + pos, buffer.end(), '\n') + 1;
+    bank.answers = AnswerMatrix(bank.questions.size(), catalog.size() + rows + 1);
+    catalog.add(Character(0, "Sorry! No Character Found.", "characters_img/None.webp"));
+
+    int id = 0;
+    while (pos < buffer.size())
+    {
+        string_view nameStr = readCSVField(buffer, pos, quoted);
+        if (nameStr.empty())
+        {
+            skipCSVLine(buffer, pos); // Blank line
+            continue;
+        }
+        string name = quoted ? unquoteCSV(nameStr) : string(nameStr);
+        int index = catalog.add(Character(++id, name, "characters_img/" + name + ".webp"));
+
+        for (size_t q = 0; q < bank.questions.size(); q++)
+        {
+            string_view value = readCSVField(buffer, pos, quoted);
+            if (value == "1")
+            {
+                bank.answers.set(index, (int)q, POSITIVE);
+            }
+            else if (value == "0")
+            {
+                bank.answers.set(index, (int)q, NEGATIVE);
+            }
+        }
+        skipCSVLine(buffer, pos);
+    }
+
+    return bank;
+}
+
+// Outcomes stored in TreeNode::character when a leaf does not identify a single character.
+enum LeafResult
+{
+    NO_MATCH = -1,          // The answers ruled out every character
+    NO_MORE_QUESTIONS = -2, // Characters remain but the question bank is used up
+    UNDIFFERENTIATED = -3   // No question separates the remaining characters
+};
+
+// A node of the decision tree while it is being built. Internal nodes refer to their question by index into
+// the tree's question bank; leaves store only their result.
+struct TreeNode
+{
+    int question;       // Index into the question bank, or -1 for a leaf
+    int character;      // Leaf result: the identified character's index or a LeafResult
+    TreeNode *left;     // "yes" subtree
+    TreeNode *right;    // "no" subtree
+};
+
+// Hands out TreeNodes from a few large blocks, all released together when the arena is destroyed.
+class NodeArena
+{
+private:
+    vector<unique_ptr<TreeNode[]>> blocks; // Each block is twice the size of the one before
+    size_t block_size = 0;                 // Capacity of the newest block
+    size_t used = 0;                       // Nodes handed out from the newest block
+
+public:
+    TreeNode *allocate(int question, int character)
+    {
+        /*
+        Desc: Returns a fresh node with no children.
+        returns:
+        (TreeNode*): A node owned by the arena.
+        Parameters:
+            question (int): Question bank index, or -1 for a leaf.
+            character (int): Leaf result, ignored for internal nodes.
+        */
+        if (used == block_size)
+        {
+            block_size = block_size ? block_size * 2 : 256;
+            blocks.emplace_back(new TreeNode[block_size]);
+            used = 0;
+        }
+        TreeNode *node = &blocks.back()[used++];
+        *node = TreeNode{question, character, nullptr, nullptr};
+        return node;
+    }
+};
+
+// A node of the flattened tree that games traverse. Only the fields needed to step through the tree are kept
+// here; question text and ID sets stay in the question bank.
+struct FlatNode
+{
+    uint32_t yes;   // Index of the "yes" child, or NO_CHILD for a leaf
+    uint32_t no;    // Index of the "no" child, or NO_CHILD for a leaf
+    int32_t label;  // Question bank index for internal nodes; identified character index or LeafResult for leaves
+
+    static const uint32_t NO_CHILD = 0xFFFFFFFFu;
+    static const uint32_t NOT_BUILT = 0xFFFFFFFEu; // Both children of an internal node of a lazily built tree
+
+    bool isLeaf() const { return yes == NO_CHILD; }
+};
+
+// How buildTree ranks candidate questions. Every criterion also sees the characters in neither of a question's
+// sets, which the tree cannot narrow down any further.
+enum SplitCriterion
+{
+    BALANCE,            // Smallest difference between the "yes" and "no" sides
+    INFORMATION_GAIN,   // Largest expected reduction in entropy over the remaining characters
+    GINI,               // Smallest expected Gini impurity of the branch the answer leads to
+    EXPECTED_REMAINING  // Fewest characters expected to remain after the answer
+};
+
+// What the tree builder optimizes.
+enum TreeObjective
+{
+    GREEDY,             // Pick the best question by SplitCriterion at each node
+    MIN_EXPECTED_DEPTH, // Search for the fewest questions per game on average over all characters
+    MIN_WORST_DEPTH     // Search for the fewest questions in the longest game
+};
+
+// Options that change how the tree is built.
+struct BuildOptions
+{
+    SplitCriterion criterion = BALANCE; // How to choose the question at each node; also orders the optimal search
+    TreeObjective objective = GREEDY;   // Greedy build, or an optimal search
+    double time_budget = 2.0;           // Seconds the optimal search may run before settling for its best tree
+    bool lazy = false;                  // Build each node the first time a game reaches it; always greedy
+    unsigned threads = 1;               // Threads used for the build; 0 uses every hardware thread
+    size_t parallel_cutoff = 64;        // Sets with fewer characters are built serially within one task
+};
+
+// A fixed set of worker threads with one task deque each. Threads run their newest task first and, when their
+// own deque is empty, steal the oldest task of another thread, which tends to be the largest piece of work.
+// Threads outside the pool share one extra deque, and help run tasks while they wait.
+class TaskPool
+{
+private:
+    struct TaskQueue
+    {
+        mutex lock;
+        deque<function<void()>> tasks;
+    };
+
+    vector<unique_ptr<TaskQueue>> queues;   // queues[i] belongs to worker i; the last one to outside threads
+    vector<thread> workers;
+    atomic<bool> stopping;
+    mutex idle_lock;                        // Only guards sleeping, not the queues
+    condition_variable idle;
+
+    static thread_local TaskPool *current_pool;  // Pool the calling thread works for, if any
+    static thread_local size_t current_queue;    // Index of the calling worker's own queue
+
+    size_t ownQueue() const
+    {
+        return current_pool == this ? current_queue : queues.size() - 1;
+    }
+
+    bool runOne()
+    {
+        /*
+        Desc: Runs one task: the newest from the caller's own queue, else the oldest from another queue.
+        returns:
+        (bool): False if every queue was empty.
+        */
+        size_t self = ownQueue();
+        function<void()> task;
+        {
+            lock_guard<mutex> guard(queues[self]->lock);
+            if (!queues[self]->tasks.empty())
+            {
+                task = move(queues[self]->tasks.back());
+                queues[self]->tasks.pop_back();
+            }
+        }
+        for (size_t i = 1; !task && i < queues.size(); i++)
+        {
+            TaskQueue &victim = *queues[(self + i) % queues.size()];
+            lock_guard<mutex> guard(victim.lock);
+            if (!victim.tasks.empty())
+            {
+                task = move(victim.tasks.front());
+                victim.tasks.pop_front();
+            }
+        }
+        if (!task)
+        {
+            return false;
+        }
+        task();
+        return true;
+    }
+
+public:
+    // Constructor
+    TaskPool(size_t threads) : stopping(false)
+    {
+        for (size_t i = 0; i <= threads; i++)
+        {
+            queues.emplace_back(new TaskQueue());
+        }
+        for (size_t i = 0; i < threads; i++)
+        {
+            workers.emplace_back([this, i] {
+                current_pool = this;
+                current_queue = i;
+                while (!stopping.load())
+                {
+                    if (!runOne())
+                    {
+                        unique_lock<mutex> lock(idle_lock);
+                        idle.wait_for(lock, chrono::milliseconds(1));
+                    }
+                }
+            });
+        }
+    }
+
+    ~TaskPool()
+    {
+        stopping = true;
+        idle.notify_all();
+        for (thread &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    TaskPool(const TaskPool &) = delete;
+    TaskPool &operator=(const TaskPool &) = delete;
+
+    void submit(function<void()> task)
+    {
+        /*
+        Desc: Queues a task on the calling thread's deque, where idle workers can steal it.
+        Parameters:
+            task (function<void()>): The work to run.
+        */
+        TaskQueue &queue = *queues[ownQueue()];
+        {
+            lock_guard<mutex> guard(queue.lock);
+            queue.tasks.push_back(move(task));
+        }
+        idle.notify_one();
+    }
+
+    void waitFor(const atomic<int> &pending)
+    {
+        /*
+        Desc: Runs queued tasks until a counter of outstanding tasks drops to zero.
+        Parameters:
+            pending (const atomic<int> &): Decremented by each awaited task when it finishes.
+        */
+        while (pending.load(memory_order_acquire) > 0)
+        {
+            if (!runOne())
+            {
+                this_thread::yield();
+            }
+        }
+    }
+
+    void parallelFor(size_t count, size_t grain, const function<void(size_t, size_t)> &body)
+    {
+        /*
+        Desc: Runs body over [0, count) in chunks of grain items spread over the pool, and waits for all of them.
+        Parameters:
+            count (size_t): Number of items.
+            grain (size_t): Items per chunk.
+            body (const function<void(size_t, size_t)> &): Called with the [begin, end) range of each chunk.
+        */
+        atomic<int> pending(0);
+        for (size_t begin = grain; begin < count; begin += grain)
+        {
+            pending.fetch_add(1);
+            submit([&body, &pending, begin, count, grain] {
+                body(begin, min(count, begin + grain));
+                pending.fetch_sub(1, memory_order_release);
+            });
+        }
+        body(0, min(count, grain));
+        waitFor(pending);
+    }
+};
+
+thread_local TaskPool *TaskPool::current_pool = nullptr;
+thread_local size_t TaskPool::current_queue = 0;
+
+// State that belongs to one path from the root while building; every parallel task works on its own copy.
+struct BuildPath
+{
+    Bitset asked;               // Questions asked on the path to the node being built
+    size_t asked_count = 0;     // Number of questions in asked
+    vector<int> yes_counts;     // Scratch: remaining "yes" characters per question
+    vector<int> no_counts;      // Scratch: remaining "no" characters per question
+};
+
+double scoreSplit(SplitCriterion criterion, int yes, int no, int total)
+{
+    /*
+    Desc: Scores splitting a set of characters with a question; lower scores are better.
+    returns:
+    (double): The score of the split under the given criterion.
+    Parameters:
+        criterion (SplitCriterion): How to score.
+        yes (int): Remaining characters answering "yes".
+        no (int): Remaining characters answering "no".
+        total (int): All remaining characters; the ones not in yes or no are unknown for this question.
+    */
+    int unknown = total - yes - no;
+    switch (criterion)
+    {
+    case INFORMATION_GAIN:
+    {
+        // Expected entropy left after the answer, with every remaining character equally likely. Unknown
+        // characters follow both branches, so each branch holds them too; an unknown character is as likely
+        // to give either answer, so half of them weigh on each side.
+        auto entropy = [](int n) { return n > 0 ? log2((double)n) : 0.0; };
+        return ((yes + unknown / 2.0) * entropy(yes + unknown) + (no + unknown / 2.0) * entropy(no + unknown)) /
+               total;
+    }
+    case GINI:
+    {
+        // Expected Gini impurity of the branch the answer leads to, weighted like INFORMATION_GAIN. A branch
+        // of m equally likely characters has impurity 1 - 1/m.
+        auto impurity = [](int n) { return n > 0 ? 1.0 - 1.0 / n : 0.0; };
+        return ((yes + unknown / 2.0) * impurity(yes + unknown) + (no + unknown / 2.0) * impurity(no + unknown)) /
+               total;
+    }
+    case EXPECTED_REMAINING:
+        // Unknown characters stay among the candidates whatever the answer.
+        return ((double)yes * yes + (double)no * no + (double)unknown * total) / total;
+    case BALANCE:
+    default:
+        return abs(yes - no) + unknown;
+    }
+}
+
+void countSplits(const AnswerMatrix &answers, const Bitset &remaining_ids, int *yes_counts, int *no_counts,
+                 size_t begin, size_t end)
+{
+    /*
+    Desc: Counts how questions [begin, end) split a set, in one linear pass over the question-major planes of the
+          answer matrix.
+    Parameters:
+        answers (const AnswerMatrix &): Every character's answer to every question.
+        remaining_ids (const Bitset &): The characters being split.
+        yes_counts (int *): Receives the number of "yes" characters, by question index.
+        no_counts (int *): Receives the number of "no" characters, by question index.
+        begin (size_t): First question to count.
+        end (size_t): One past the last question to count.
+    */
+    size_t mask_words = answers.characterWords();
+    size_t words = min(remaining_ids.words.size(), mask_words);
+    const uint64_t *remaining = remaining_ids.words.data();
+    const uint64_t *row = answers.characters((int)begin, POSITIVE);
+    for (size_t q = begin; q < end; q++, row += 2 * mask_words)
+    {
+        int yes = 0, no = 0;
+        for (size_t w = 0; w < words; w++)
+        {
+            yes += __builtin_popcountll(remaining[w] & row[w]);
+            no += __builtin_popcountll(remaining[w] & row[mask_words + w]);
+        }
+        yes_counts[q] = yes;
+        no_counts[q] = no;
+    }
+}
+
+int bestSplit(SplitCriterion criterion, const Bitset &excluded, const int *yes_counts, const int *no_counts,
+              size_t question_count, int total)
+{
+    /*
+    Desc: Picks the best-scoring question from counts made by countSplits, among those not excluded that put
+          characters on both sides. Ties go to the lowest index. The tree builder and Session both choose
+          their questions this way.
+    returns:
+    (int): Question index, or -1 if no question separates the set.
+    Parameters:
+        criterion (SplitCriterion): How to score.
+        excluded (const Bitset &): Questions not to ask, such as those already asked.
+        yes_counts (const int *): "Yes" characters by question index.
+        no_counts (const int *): "No" characters by question index.
+        question_count (size_t): Number of questions counted.
+        total (int): Size of the set being split.
+    */
+    int best_question = -1;
+    double best_score = INFINITY;
+
+    for (int q = 0; q < (int)question_count; q++)
+    {
+        if (excluded.contains(q))
+        {
+            continue;
+        }
+
+        int pos_count = yes_counts[q];
+        int neg_count = no_counts[q];
+
+        if (pos_count == 0 || neg_count == 0)
+        {
+            // Skip: asking this would not narrow the set down
+            continue;
+        }
+
+        double score = scoreSplit(criterion, pos_count, neg_count, total);
+        if (score < best_score)
+        {
+            best_score = score;
+            best_question = q;
+        }
+    }
+    return best_question;
+}
+
+// Builds the decision tree for a question bank. Only lives while a QuestionTree is being constructed.
+class TreeBuilder
+{
+private:
+    const AnswerMatrix &answers;                            // Answers to every question; nodes refer to questions by index
+    BuildOptions options;                                   // Split criterion and other build settings
+    TaskPool *pool;                                         // Workers for a parallel build, nullptr for serial
+    NodeArena arena;                                        // Storage for the nodes being built
+    mutex arena_lock;                                       // Guards arena during parallel builds
+    unordered_map<Bitset, TreeNode *, BitsetHash> subtrees; // Subtrees already built, keyed by their remaining set
+    mutex subtrees_lock;                                    // Guards subtrees during parallel builds
+
+    static const size_t SCORING_GRAIN = 256;                // Questions per task when scoring in parallel
+
+    // What the optimal search knows about one set of characters.
+    struct SearchEntry
+    {
+        int cost = -1;          // Cost of the best tree found for the set, or -1 if none yet
+        int question = -1;      // Question at the root of that tree
+        int lower = 0;          // No tree for the set costs less than this
+        bool optimal = false;   // cost is proven minimal
+    };
+
+    static const int NO_TREE = 1 << 29;                       // Larger than any real cost
+    unordered_map<Bitset, SearchEntry, BitsetHash> search;    // Optimal search results by remaining set
+    chrono::steady_clock::time_point deadline;                // When the optimal search stops improving
+    bool out_of_time = false;                                 // The deadline has passed
+    vector<int> profile_of;                                   // Profile group of each character, -1 if any answer is unknown
+    vector<int> profile_sizes;                                // Scratch counts per profile group
+
+    TreeNode *allocate(int question, int character)
+    {
+        lock_guard<mutex> guard(arena_lock);
+        return arena.allocate(question, character);
+    }
+
+    TreeNode *remember(const Bitset &remaining_ids, TreeNode *node)
+    {
+        /*
+        Desc: Records a finished subtree. If another task finished the same set first, its subtree is kept.
+        returns:
+        (TreeNode*): The subtree now recorded for the set.
+        Parameters:
+            remaining_ids (const Bitset &): The set the subtree distinguishes.
+            node (TreeNode *): Root of the subtree.
+        */
+        lock_guard<mutex> guard(subtrees_lock);
+        return subtrees.emplace(remaining_ids, node).first->second;
+    }
+
+public:
+    // Constructor
+    TreeBuilder(const AnswerMatrix &matrix, const BuildOptions &opts = BuildOptions(), TaskPool *workers = nullptr)
+        : answers(matrix), options(opts), pool(workers) {}
+
+    const AnswerMatrix &getAnswers() const { return answers; }
+
+    int chooseQuestion(const Bitset &remaining_ids, BuildPath &path, bool parallel = false)
+    {
+        /*
+        Desc: Picks the question that best splits a set under the configured criterion, among those not yet
+              asked on the path that put characters on both sides.
+        returns:
+        (int): Question index, or -1 if no question separates the set.
+        Parameters:
+            remaining_ids (const Bitset &): The characters to split.
+            path (BuildPath &): Questions asked on the way here; its counts are used as scratch space.
+            parallel (bool): Score the questions in parallel chunks on the builder's pool.
+        */
+        size_t question_count = answers.questionCount();
+        int remaining_count = (int)remaining_ids.size();
+        if (parallel && question_count > SCORING_GRAIN)
+        {
+            pool->parallelFor(question_count, SCORING_GRAIN, [&](size_t begin, size_t end) {
+                countSplits(answers, remaining_ids, path.yes_counts.data(), path.no_counts.data(), begin, end);
+            });
+        }
+        else
+        {
+            countSplits(answers, remaining_ids, path.yes_counts.data(), path.no_counts.data(), 0, question_count);
+        }
+        return bestSplit(options.criterion, path.asked, path.yes_counts.data(), path.no_counts.data(), question_count,
+                         remaining_count);
+    }
+
+    TreeNode* buildTree(const Bitset &remaining_ids)
+    {
+        /*
+        Desc: Builds the decision tree distinguishing a set of characters, in parallel if the builder has a pool.
+        returns:
+        (TreeNode*): A pointer to the root of the decision tree.
+        Parameters:
+            remaining_ids (const Bitset &): The set of characters that need to be distinguished.
+        */
+        BuildPath path;
+        path.asked.words.assign(answers.questionWords(), 0);
+        path.yes_counts.resize(answers.questionCount());
+        path.no_counts.resize(answers.questionCount());
+        if (options.objective != GREEDY)
+        {
+            return buildOptimalTree(remaining_ids, path);
+        }
+        return buildTree(remaining_ids, path);
+    }
+
+    TreeNode* buildTree(const Bitset &remaining_ids, BuildPath &path)
+    {
+        /*
+        Desc: Recursively builds a decision tree by selecting questions that best split the set of remaining characters.
+        returns:
+        (TreeNode*): A pointer to the root of the decision tree.
+        Parameters:
+            remaining_ids (const Bitset &): The set of characters that need to be distinguished.
+            path (BuildPath &): Questions asked on the way here and scratch space; restored before returning.
+        */
+        size_t remaining_count = remaining_ids.size();
+        if (remaining_count == 0)
+        {
+            // Terminal condition: the answers ruled out every character
+            return allocate(-1, NO_MATCH);
+        }
+
+        if (remaining_count == 1)
+        {
+            // Terminal condition: only one character left
+            return allocate(-1, remaining_ids.first());
+        }
+
+        size_t question_count = answers.questionCount();
+        if (path.asked_count == question_count)
+        {
+            // Terminal condition: no more questions
+            return allocate(-1, NO_MORE_QUESTIONS);
+        }
+
+        // Every question already asked on the path puts the whole set on one side, and such questions are
+        // skipped anyway, so the subtree depends on remaining_ids alone.
+        {
+            lock_guard<mutex> guard(subtrees_lock);
+            auto built = subtrees.find(remaining_ids);
+            if (built != subtrees.end())
+            {
+                return built->second;
+            }
+        }
+
+        // Select the best question under the configured criterion. Large sets near the root score the
+        // questions in parallel chunks.
+        bool parallel = pool && remaining_count >= options.parallel_cutoff;
+        int best_question = chooseQuestion(remaining_ids, path, parallel);
+
+        if (best_question < 0)
+        {
+            // No remaining question separates these characters
+            return remember(remaining_ids, allocate(-1, UNDIFFERENTIATED));
+        }
+
+        // Partition remaining IDs
+        Bitset pos_ids = answers.branch(remaining_ids, best_question, true);
+        Bitset neg_ids = answers.branch(remaining_ids, best_question, false);
+
+        // Mark the chosen question as asked while its subtrees are built
+        path.asked.insert(best_question);
+        path.asked_count++;
+
+        // Recursively build subtrees
+        TreeNode *node = allocate(best_question, 0);
+        if (parallel)
+        {
+            // Hand the "yes" branch to the pool with its own copy of the path, and build the "no" branch here.
+            BuildPath yes_path = path;
+            atomic<int> pending(1);
+            pool->submit([this, node, &pos_ids, &yes_path, &pending] {
+                node->left = buildTree(pos_ids, yes_path);
+                pending.fetch_sub(1, memory_order_release);
+            });
+            node->right = buildTree(neg_ids, path);
+            pool->waitFor(pending);
+        }
+        else
+        {
+            node->left = buildTree(pos_ids, path);  // "yes" branch
+            node->right = buildTree(neg_ids, path); // "no" branch
+        }
+
+        path.asked.erase(best_question);
+        path.asked_count--;
+
+        return remember(remaining_ids, node);
+    }
+
+    void classifyProfiles()
+    {
+        /*
+        Desc: Groups the characters whose answers are all known by their answer profile. Characters in different
+              groups always end in different leaves, which is what the search's lower bounds rely on.
+        returns:
+        (void)
+        Parameters:
+            None
+        */
+        unordered_map<Bitset, int, BitsetHash> groups;
+        profile_of.assign(answers.characterSlots(), -1);
+        for (int c = 0; c < (int)answers.characterSlots(); c++)
+        {
+            Bitset yes(answers.questions(c, POSITIVE), answers.questionWords());
+            Bitset no(answers.questions(c, NEGATIVE), answers.questionWords());
+            if (yes.size() + no.size() == answers.questionCount())
+            {
+                profile_of[c] = groups.emplace(yes, (int)groups.size()).first->second;
+            }
+        }
+        profile_sizes.assign(groups.size(), 0);
+    }
+
+    int lowerBound(const Bitset &remaining_ids)
+    {
+        /*
+        Desc: Information-theoretic lower bound on the cost of a tree for a set. Characters with distinct known
+              profiles need distinct leaves, so with m of them the tree is at least log2(m) deep, and by Kraft's
+              inequality their depths sum to at least the entropy of the profile sizes.
+        returns:
+        (int): The bound under the configured objective.
+        Parameters:
+            remaining_ids (const Bitset &): The set to bound.
+        */
+        int known = 0, profiles = 0;
+        vector<int> seen;
+        for (size_t i = 0; i < remaining_ids.words.size(); i++)
+        {
+            for (uint64_t word = remaining_ids.words[i]; word; word &= word - 1)
+            {
+                int c = (int)(i * 64 + __builtin_ctzll(word));
+                int profile = c < (int)profile_of.size() ? profile_of[c] : -1;
+                if (profile < 0)
+                {
+                    continue;
+                }
+                if (profile_sizes[profile]++ == 0)
+                {
+                    profiles++;
+                    seen.push_back(profile);
+                }
+                known++;
+            }
+        }
+        if (profiles <= 1)
+        {
+            for (int profile : seen)
+            {
+                profile_sizes[profile] = 0;
+            }
+            return 0;
+        }
+
+        int depth = 0;
+        while ((1 << depth) < profiles)
+        {
+            depth++; // ceil(log2(profiles))
+        }
+        int bound;
+        if (options.objective == MIN_WORST_DEPTH)
+        {
+            bound = depth;
+        }
+        else if (known == profiles)
+        {
+            // Smallest external path length of a binary tree with m leaves: m*(d-1) + 2*(m - 2^(d-1))
+            bound = profiles * (depth - 1) + 2 * (profiles - (1 << (depth - 1)));
+        }
+        else
+        {
+            double entropy = 0;
+            for (int profile : seen)
+            {
+                entropy += profile_sizes[profile] * log2((double)known / profile_sizes[profile]);
+            }
+            bound = (int)ceil(entropy - 1e-9);
+        }
+        for (int profile : seen)
+        {
+            profile_sizes[profile] = 0;
+        }
+        return bound;
+    }
+
+    vector<int> splitCandidates(const Bitset &remaining_ids, BuildPath &path)
+    {
+        /*
+        Desc: Lists the questions that separate a set, one per distinct partition, best-scoring first so the
+              search finds good trees early.
+        returns:
+        (vector<int>): Question indices.
+        Parameters:
+            remaining_ids (const Bitset &): The set to split.
+            path (BuildPath &): Scratch space for the split counts.
+        */
+        int total = (int)remaining_ids.size();
+        countSplits(answers, remaining_ids, path.yes_counts.data(), path.no_counts.data(), 0, answers.questionCount());
+        vector<pair<double, int>> scored;
+        for (int q = 0; q < (int)answers.questionCount(); q++)
+        {
+            if (path.yes_counts[q] > 0 && path.no_counts[q] > 0)
+            {
+                scored.emplace_back(scoreSplit(options.criterion, path.yes_counts[q], path.no_counts[q], total), q);
+            }
+        }
+        sort(scored.begin(), scored.end());
+
+        // Questions that partition the set identically lead to identical subtrees; keep the first of each.
+        unordered_set<Bitset, BitsetHash> partitions;
+        vector<int> candidates;
+        for (auto &entry : scored)
+        {
+            Bitset side = answers.branch(remaining_ids, entry.second, true);
+            Bitset other = answers.branch(remaining_ids, entry.second, false);
+            if (other.words < side.words)
+            {
+                swap(side, other);
+            }
+            // Both sides make up the key, since characters with unknown answers are on both
+            side.words.insert(side.words.end(), other.words.begin(), other.words.end());
+            if (partitions.insert(side).second)
+            {
+                candidates.push_back(entry.second);
+            }
+        }
+        return candidates;
+    }
+
+    int seedGreedy(const Bitset &remaining_ids, BuildPath &path)
+    {
+        /*
+        Desc: Records the greedy tree for a set as the search's first solution for it and every subset on the way.
+        returns:
+        (int): The greedy tree's cost.
+        Parameters:
+            remaining_ids (const Bitset &): The set to solve.
+            path (BuildPath &): Scratch space for the split counts.
+        */
+        int n = (int)remaining_ids.size();
+        if (n <= 1)
+        {
+            return 0;
+        }
+        SearchEntry &known = search[remaining_ids];
+        if (known.cost >= 0)
+        {
+            return known.cost;
+        }
+        // The greedy question is the best-scoring candidate, so the seed costs no more than a greedy build.
+        int q = chooseQuestion(remaining_ids, path);
+        if (q < 0)
+        {
+            // Nothing separates these characters, so this is a leaf
+            search[remaining_ids] = SearchEntry{0, -1, 0, true};
+            return 0;
+        }
+        int cy = seedGreedy(answers.branch(remaining_ids, q, true), path);
+        int cn = seedGreedy(answers.branch(remaining_ids, q, false), path);
+        int cost = options.objective == MIN_WORST_DEPTH ? 1 + max(cy, cn) : n + cy + cn;
+        SearchEntry &entry = search[remaining_ids]; // The recursion may have rehashed the map
+        entry.cost = cost;
+        entry.question = q;
+        return cost;
+    }
+
+    int solve(const Bitset &remaining_ids, int bound, BuildPath &path)
+    {
+        /*
+        Desc: Branch and bound search for the cheapest tree for a set, costing at most bound. Every set is
+              solved at most once per bound thanks to the memo, and candidates whose children's lower bounds
+              already exceed the best tree found are skipped.
+        returns:
+        (int): The cost of the best tree found if it is within bound (its root question is then in the memo),
+               otherwise a number larger than bound.
+        Parameters:
+            remaining_ids (const Bitset &): The set to solve.
+            bound (int): The largest cost of interest.
+            path (BuildPath &): Scratch space for the split counts.
+        */
+        int n = (int)remaining_ids.size();
+        if (n <= 1)
+        {
+            return 0;
+        }
+        SearchEntry known = search[remaining_ids];
+        if (known.optimal)
+        {
+            return known.cost <= bound ? known.cost : bound + 1;
+        }
+        int lower = max(known.lower, lowerBound(remaining_ids));
+        if (lower > bound)
+        {
+            return lower;
+        }
+        if (out_of_time || chrono::steady_clock::now() > deadline)
+        {
+            out_of_time = true;
+            return known.cost >= 0 && known.cost <= bound ? known.cost : bound + 1;
+        }
+
+        vector<int> candidates = splitCandidates(remaining_ids, path);
+        if (candidates.empty())
+        {
+            search[remaining_ids] = SearchEntry{0, -1, 0, true};
+            return 0;
+        }
+
+        bool worst_case = options.objective == MIN_WORST_DEPTH;
+        int best = known.cost >= 0 ? known.cost : NO_TREE;
+        int best_question = known.question;
+        for (int q : candidates)
+        {
+            int target = min(best - 1, bound); // Only strictly better trees are interesting
+            Bitset yes_ids = answers.branch(remaining_ids, q, true);
+            Bitset no_ids = answers.branch(remaining_ids, q, false);
+            int lower_yes = lowerBound(yes_ids);
+            int lower_no = lowerBound(no_ids);
+
+            int cost;
+            if (worst_case)
+            {
+                if (1 + max(lower_yes, lower_no) > target)
+                {
+                    continue;
+                }
+                int cy = solve(yes_ids, target - 1, path);
+                if (cy > target - 1)
+                {
+                    continue;
+                }
+                int cn = solve(no_ids, target - 1, path);
+                if (cn > target - 1)
+                {
+                    continue;
+                }
+                cost = 1 + max(cy, cn);
+            }
+            else
+            {
+                if (n + lower_yes + lower_no > target)
+                {
+                    continue;
+                }
+                int cy = solve(yes_ids, target - n - lower_no, path);
+                if (cy > target - n - lower_no)
+                {
+                    continue;
+                }
+                int cn = solve(no_ids, target - n - cy, path);
+                if (cn > target - n - cy)
+                {
+                    continue;
+                }
+                cost = n + cy + cn;
+            }
+            best = cost;
+            best_question = q;
+        }
+
+        SearchEntry &entry = search[remaining_ids];
+        if (best < NO_TREE)
+        {
+            entry.cost = best;
+            entry.question = best_question;
+        }
+        if (!out_of_time)
+        {
+            // Every candidate was tried against min(best - 1, bound), so nothing cheaper exists within bound.
+            if (best <= bound)
+            {
+                entry.optimal = true;
+            }
+            else
+            {
+                entry.lower = max(entry.lower, bound + 1);
+            }
+        }
+        return best <= bound ? best : max(lower, bound + 1);
+    }
+
+    TreeNode *materialize(const Bitset &remaining_ids)
+    {
+        /*
+        Desc: Creates the nodes of the best tree the search recorded for a set.
+        returns:
+        (TreeNode*): Root of the tree.
+        Parameters:
+            remaining_ids (const Bitset &): The set the tree distinguishes.
+        */
+        size_t n = remaining_ids.size();
+        if (n == 0)
+        {
+            return allocate(-1, NO_MATCH);
+        }
+        if (n == 1)
+        {
+            return allocate(-1, remaining_ids.first());
+        }
+        auto known = search.find(remaining_ids);
+        if (known == search.end() || known->second.question < 0)
+        {
+            return remember(remaining_ids, allocate(-1, UNDIFFERENTIATED));
+        }
+        {
+            lock_guard<mutex> guard(subtrees_lock);
+            auto built = subtrees.find(remaining_ids);
+            if (built != subtrees.end())
+            {
+                return built->second;
+            }
+        }
+        int q = known->second.question;
+        TreeNode *node = allocate(q, 0);
+        node->left = materialize(answers.branch(remaining_ids, q, true));
+        node->right = materialize(answers.branch(remaining_ids, q, false));
+        return remember(remaining_ids, node);
+    }
+
+    TreeNode *buildOptimalTree(const Bitset &remaining_ids, BuildPath &path)
+    {
+        /*
+        Desc: Searches for the tree with the smallest expected or worst-case depth, starting from the greedy tree
+              and improving on it until the search is complete or the time budget runs out.
+        returns:
+        (TreeNode*): Root of the best tree found.
+        Parameters:
+            remaining_ids (const Bitset &): The set of characters that need to be distinguished.
+            path (BuildPath &): Scratch space for the split counts.
+        */
+        deadline = chrono::steady_clock::now() +
+                   chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(options.time_budget));
+        out_of_time = false;
+        classifyProfiles();
+        int greedy = seedGreedy(remaining_ids, path);
+        solve(remaining_ids, greedy, path);
+        TreeNode *root = materialize(remaining_ids);
+        search.clear();
+        return root;
+    }
+
+    vector<FlatNode> flatten(const TreeNode *root) const
+    {
+        /*
+        Desc: Copies the built tree into a contiguous node array in breadth-first order, so the first levels
+              that every game visits sit together. Subtrees shared through memoization are stored once.
+        returns:
+        (vector<FlatNode>): The nodes; the root is at index 0.
+        Parameters:
+            root (const TreeNode *): Root of the tree produced by buildTree.
+        */
+        unordered_map<const TreeNode *, uint32_t> index;
+        vector<const TreeNode *> order = {root};
+        index[root] = 0;
+
+        // Number the nodes in breadth-first order; order doubles as the queue.
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            for (const TreeNode *child : {order[i]->left, order[i]->right})
+            {
+                if (child && index.find(child) == index.end())
+                {
+                    index[child] = (uint32_t)order.size();
+                    order.push_back(child);
+                }
+            }
+        }
+
+        vector<FlatNode> nodes(order.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            const TreeNode *node = order[i];
+            if (node->question < 0)
+            {
+                nodes[i] = FlatNode{FlatNode::NO_CHILD, FlatNode::NO_CHILD, node->character};
+            }
+            else
+            {
+                nodes[i] = FlatNode{index[node->left], index[node->right], node->question};
+            }
+        }
+        return nodes;
+    }
+};
+
+// Nodes of a tree built on demand: a node's children are only built the first time a game steps to them, so
+// memory and build time follow the paths games actually take. Built nodes never move or change, and any number of
+// games can step through the tree at once.
+class LazyTree
+{
+private:
+    struct LazyNode
+    {
+        FlatNode node;                  // Children are NOT_BUILT for internal nodes; see children
+        atomic<uint32_t> children[2];   // Indices of the "yes" and "no" children once built, NOT_BUILT before
+        Bitset remaining;               // Characters that reach this node
+    };
+
+    static const size_t FIRST_BLOCK = 64;                     // Nodes in block 0; each block doubles the last
+    static const int MAX_BLOCKS = 26;                         // Room for 64 * (2^26 - 1) nodes
+    unique_ptr<LazyNode[]> blocks[MAX_BLOCKS];                // Node storage; blocks are never reallocated
+    atomic<uint32_t> count;                                   // Nodes built so far
+    TreeBuilder builder;                                      // Chooses each node's question
+    BuildPath path;                                           // Scratch space for scoring
+    unordered_map<Bitset, uint32_t, BitsetHash> built;        // Nodes already built, keyed by their remaining set
+    mutex lock;                                               // Serializes building; reading built nodes needs no lock
+
+    LazyNode &slot(uint32_t index) const
+    {
+        size_t block = 63 - __builtin_clzll(index / FIRST_BLOCK + 1);
+        return blocks[block][index - FIRST_BLOCK * ((size_t(1) << block) - 1)];
+    }
+
+    uint32_t addNode(const Bitset &remaining_ids)
+    {
+        /*
+        Desc: Builds the node for a set, or finds the one already built for it. Must hold lock.
+        returns:
+        (uint32_t): Index of the node.
+        Parameters:
+            remaining_ids (const Bitset &): The characters that reach the node.
+        */
+        auto known = built.find(remaining_ids);
+        if (known != built.end())
+        {
+            return known->second;
+        }
+
+        uint32_t index = count.load(memory_order_relaxed);
+        size_t block = 63 - __builtin_clzll(index / FIRST_BLOCK + 1);
+        if (block >= (size_t)MAX_BLOCKS)
+        {
+            throw runtime_error("Lazy tree is full");
+        }
+        if (!blocks[block])
+        {
+            blocks[block].reset(new LazyNode[FIRST_BLOCK << block]);
+        }
+
+        LazyNode &entry = slot(index);
+        size_t remaining_count = remaining_ids.size();
+        int question = remaining_count > 1 ? builder.chooseQuestion(remaining_ids, path) : -1;
+        if (question >= 0)
+        {
+            entry.node = FlatNode{FlatNode::NOT_BUILT, FlatNode::NOT_BUILT, question};
+        }
+        else
+        {
+            int32_t label = remaining_count == 0 ? NO_MATCH
+                          : remaining_count == 1 ? remaining_ids.first() : UNDIFFERENTIATED;
+            entry.node = FlatNode{FlatNode::NO_CHILD, FlatNode::NO_CHILD, label};
+        }
+        entry.children[0].store(FlatNode::NOT_BUILT, memory_order_relaxed);
+        entry.children[1].store(FlatNode::NOT_BUILT, memory_order_relaxed);
+        entry.remaining = remaining_ids;
+
+        built.emplace(remaining_ids, index);
+        count.store(index + 1, memory_order_release);
+        return index;
+    }
+
+public:
+    // Constructor
+    LazyTree(const AnswerMatrix &answers, const BuildOptions &options, const Bitset &characters)
+        : count(0), builder(answers, options)
+    {
+        /*
+        Desc: Builds the root only.
+        Parameters:
+            answers (const AnswerMatrix &): Answers to every question; must outlive the tree.
+            options (const BuildOptions &): The split criterion to build with.
+            characters (const Bitset &): Indices of all characters.
+        */
+        path.asked.words.assign(answers.questionWords(), 0);
+        path.yes_counts.resize(answers.questionCount());
+        path.no_counts.resize(answers.questionCount());
+        lock_guard<mutex> guard(lock);
+        addNode(characters);
+    }
+
+    const FlatNode &get(uint32_t index) const { return slot(index).node; }
+    size_t size() const { return count.load(memory_order_acquire); }
+
+    uint32_t child(uint32_t index, bool answer)
+    {
+        /*
+        Desc: Steps from an internal node to one of its children, building the child if no game has reached it
+              before. The child is fully built before its index is published, so other games either see it
+              finished or build it here under the lock.
+        returns:
+        (uint32_t): Index of the child.
+        Parameters:
+            index (uint32_t): An internal node.
+            answer (bool): True for the "yes" child.
+        */
+        LazyNode &entry = slot(index);
+        atomic<uint32_t> &link = entry.children[answer ? 0 : 1];
+        uint32_t next = link.load(memory_order_acquire);
+        if (next != FlatNode::NOT_BUILT)
+        {
+            return next;
+        }
+
+        lock_guard<mutex> guard(lock);
+        next = link.load(memory_order_relaxed);
+        if (next == FlatNode::NOT_BUILT)
+        {
+            next = addNode(builder.getAnswers().branch(entry.remaining, entry.node.label, answer));
+            link.store(next, memory_order_release);
+        }
+        return next;
+    }
+};
+
+// Fixed-size header at the start of a tree snapshot. Every section offset is in bytes from the start of the
+// snapshot and is 8-byte aligned, so a mapped snapshot file is used in place with no parsing.
+struct SnapshotHeader
+{
+    char magic[8];                  // "AKITREE" and a NUL
+    uint32_t version;               // SNAPSHOT_VERSION
+    uint32_t nodeCount;             // FlatNodes in the tree
+    uint32_t questionCount;         // Questions in the bank
+    uint32_t maskWords;             // 64-bit words in each character mask
+    uint32_t catalogSize;           // Characters in the catalog
+    uint32_t criterion;             // SplitCriterion the tree was built with
+    uint32_t objective;             // TreeObjective the tree was built with
+    uint32_t reserved;              // Always 0
+    uint64_t sourceChecksum;        // checksumFiles of the CSVs the tree was built from
+    uint64_t totalSize;             // Size of the whole snapshot in bytes
+    uint64_t nodesOffset;           // FlatNode[nodeCount]
+    uint64_t questionPlanesOffset;  // uint64_t[questionCount][2][maskWords]: AnswerMatrix planes by question
+    uint64_t characterPlanesOffset; // uint64_t[maskWords * 64][2][question words]: AnswerMatrix planes by character
+    uint64_t universeOffset;        // uint64_t[maskWords]: every character index
+    uint64_t textOffsetsOffset;     // uint32_t[questionCount + 1]: where each question's text starts in the text section
+    uint64_t textOffset;            // char[]: question text, back to back
+    uint64_t questionIdsOffset;     // int32_t[questionCount]: q_id of each question, by index
+    uint64_t catalogIdsOffset;      // int32_t[catalogSize]: char_id of each character, by index
+    uint64_t catalogOffsetsOffset;  // uint32_t[2 * catalogSize + 1]: name then image path of each character in the catalog text
+    uint64_t catalogTextOffset;     // char[]: catalog strings, back to back
+};
+
+const char SNAPSHOT_MAGIC[8] = "AKITREE";
+const uint32_t SNAPSHOT_VERSION = 6;
+
+// The tree is built once and never modified afterwards, so a single instance can be shared (and read
+// concurrently) by any number of games. Per-game state lives in Session. Adding characters or questions
+// produces a new tree; games already playing finish on the old one.
+//
+// Whether it was built from the CSVs or loaded from a snapshot file, the tree lives in a single snapshot
+// image and every accessor reads straight from it.
+class QuestionTree
+{
+private:
+    vector<uint64_t> image;             // Snapshot image of a tree built in this process
+    unique_ptr<MappedFile> mapping;     // Snapshot file the tree was loaded from
+    const SnapshotHeader *header = nullptr;
+    const FlatNode *nodes = nullptr;    // The tree in breadth-first order, then any later insertions; nodes[0] is the root
+    AnswerMatrix answers;               // Every character's answer to every question
+    const uint64_t *universe = nullptr; // Every character index
+    const uint32_t *textOffsets = nullptr;
+    const int32_t *questionIds = nullptr;   // ID of each question, by index
+    const char *text = nullptr;
+    CharacterCatalog catalog;           // Characters by ID, loaded once.
+    unique_ptr<LazyTree> lazy;          // Nodes of a lazily built tree, which replace the image's nodes
+
+    void build(const string &filename, const string &charactersFilename, uint64_t checksum,
+               const BuildOptions &options)
+    {
+        /*
+        Desc: Parses the CSVs and builds the tree from them.
+        Parameters:
+            filename (const string &): The path to the questions CSV file.
+            charactersFilename (const string &): The path to the characters CSV file.
+            checksum (uint64_t): Checksum of both CSVs, recorded in the snapshot.
+            options (const BuildOptions &): How to build the tree.
+        */
+        CharacterCatalog characterCatalog(charactersFilename);
+        build(readQuestionsFromCSV(filename, characterCatalog), characterCatalog, checksum, options);
+    }
+
+    void build(const QuestionBank &bank, const CharacterCatalog &characterCatalog, uint64_t checksum,
+               const BuildOptions &options)
+    {
+        /*
+        Desc: Builds and flattens the tree, and packs everything into the snapshot image.
+        Parameters:
+            bank (const QuestionBank &): The questions and their answers, by catalog index.
+            characterCatalog (const CharacterCatalog &): Every character.
+            checksum (uint64_t): Checksum of the data the bank came from, recorded in the snapshot.
+            options (const BuildOptions &): How to build the tree.
+        */
+        // Every character in the catalog can be guessed, except ID 0, the "no character found" entry.
+        Bitset characters;
+        for (int index = 0; index < (int)min(characterCatalog.size(), bank.answers.characterSlots()); index++)
+        {
+            if (characterCatalog.at(index).char_id != 0)
+            {
+                characters.insert(index);
+            }
+        }
+
+        if (options.lazy)
+        {
+            // The image holds a single placeholder node; the real nodes are built as games reach them.
+            vector<FlatNode> placeholder = {FlatNode{FlatNode::NO_CHILD, FlatNode::NO_CHILD, UNDIFFERENTIATED}};
+            pack(placeholder, bank, characterCatalog, characters, checksum, options);
+            attach((const char *)image.data(), image.size() * sizeof(uint64_t));
+            lazy.reset(new LazyTree(answers, options, characters));
+            return;
+        }
+
+        // The calling thread helps while it waits, so the pool gets one thread fewer than requested.
+        unsigned threads = options.threads ? options.threads : max(1u, thread::hardware_concurrency());
+        unique_ptr<TaskPool> pool(threads > 1 ? new TaskPool(threads - 1) : nullptr);
+        TreeBuilder builder(bank.answers, options, pool.get());
+        vector<FlatNode> flat = builder.flatten(builder.buildTree(characters));
+
+        pack(flat, bank, characterCatalog, characters, checksum, options);
+        attach((const char *)image.data(), image.size() * sizeof(uint64_t));
+    }
+
+    void pack(const vector<FlatNode> &flat, const QuestionBank &bank,
+              const CharacterCatalog &characterCatalog, const Bitset &characters, uint64_t checksum,
+              const BuildOptions &options)
+    {
+        /*
+        Desc: Lays the tree, question bank and catalog out as a snapshot image in the image member.
+        Parameters:
+            flat (const vector<FlatNode> &): The flattened tree.
+            bank (const QuestionBank &): The questions the nodes refer to, and their answers.
+            characterCatalog (const CharacterCatalog &): Every character.
+            characters (const Bitset &): Indices of all characters.
+            checksum (uint64_t): Checksum of the source CSVs.
+            options (const BuildOptions &): The options the tree was built with.
+        */
+        const vector<Question> &questions = bank.questions;
+        uint32_t maskWords = (uint32_t)bank.answers.characterWords();
+
+        // Gather the strings first so every section size is known.
+        vector<uint32_t> questionOffsets = {0};
+        vector<int32_t> questionIdList;
+        string questionText;
+        for (const Question &q : questions)
+        {
+            questionIdList.push_back(q.q_id);
+            questionText += q.text;
+            questionOffsets.push_back((uint32_t)questionText.size());
+        }
+        uint32_t catalogSize = (uint32_t)characterCatalog.size();
+        vector<int32_t> catalogIds(catalogSize);
+        vector<uint32_t> catalogOffsets = {0};
+        string catalogText;
+        for (uint32_t index = 0; index < catalogSize; index++)
+        {
+            const Character &character = characterCatalog.at(index);
+            catalogIds[index] = character.char_id;
+            catalogText += character.name;
+            catalogOffsets.push_back((uint32_t)catalogText.size());
+            catalogText += character.image_path;
+            catalogOffsets.push_back((uint32_t)catalogText.size());
+        }
+
+        SnapshotHeader head = {};
+        memcpy(head.magic, SNAPSHOT_MAGIC, sizeof(head.magic));
+        head.version = SNAPSHOT_VERSION;
+        head.nodeCount = (uint32_t)flat.size();
+        head.questionCount = (uint32_t)questions.size();
+        head.maskWords = maskWords;
+        head.catalogSize = catalogSize;
+        head.criterion = options.criterion;
+        head.objective = options.objective;
+        head.sourceChecksum = checksum;
+
+        // Assign 8-byte aligned offsets to the sections in file order.
+        uint64_t size = sizeof(SnapshotHeader);
+        auto place = [&size](uint64_t bytes) {
+            size = (size + 7) & ~uint64_t(7);
+            uint64_t offset = size;
+            size += bytes;
+            return offset;
+        };
+        head.nodesOffset = place(flat.size() * sizeof(FlatNode));
+        head.questionPlanesOffset = place(bank.answers.questionPlanesSize() * sizeof(uint64_t));
+        head.characterPlanesOffset = place(bank.answers.characterPlanesSize() * sizeof(uint64_t));
+        head.universeOffset = place((uint64_t)maskWords * sizeof(uint64_t));
+        head.textOffsetsOffset = place(questionOffsets.size() * sizeof(uint32_t));
+        head.textOffset = place(questionText.size());
+        head.questionIdsOffset = place(questionIdList.size() * sizeof(int32_t));
+        head.catalogIdsOffset = place(catalogIds.size() * sizeof(int32_t));
+        head.catalogOffsetsOffset = place(catalogOffsets.size() * sizeof(uint32_t));
+        head.catalogTextOffset = place(catalogText.size());
+        head.totalSize = (size + 7) & ~uint64_t(7);
+
+        image.assign(head.totalSize / sizeof(uint64_t), 0);
+        char *base = (char *)image.data();
+        memcpy(base, &head, sizeof(head));
+        memcpy(base + head.nodesOffset, flat.data(), flat.size() * sizeof(FlatNode));
+        memcpy(base + head.questionPlanesOffset, bank.answers.questionPlanes(),
+               bank.answers.questionPlanesSize() * sizeof(uint64_t));
+        memcpy(base + head.characterPlanesOffset, bank.answers.characterPlanes(),
+               bank.answers.characterPlanesSize() * sizeof(uint64_t));
+        copy(characters.words.begin(), characters.words.begin() + min((size_t)maskWords, characters.words.size()),
+             (uint64_t *)(base + head.universeOffset));
+        memcpy(base + head.textOffsetsOffset, questionOffsets.data(), questionOffsets.size() * sizeof(uint32_t));
+        memcpy(base + head.textOffset, questionText.data(), questionText.size());
+        memcpy(base + head.questionIdsOffset, questionIdList.data(), questionIdList.size() * sizeof(int32_t));
+        memcpy(base + head.catalogIdsOffset, catalogIds.data(), catalogIds.size() * sizeof(int32_t));
+        memcpy(base + head.catalogOffsetsOffset, catalogOffsets.data(), catalogOffsets.size() * sizeof(uint32_t));
+        memcpy(base + head.catalogTextOffset, catalogText.data(), catalogText.size());
+    }
+
+    bool attach(const char *base, size_t size)
+    {
+        /*
+        Desc: Points the accessors at a snapshot image after checking that it is complete and of this version.
+        returns:
+        (bool): False if the image is truncated, corrupt or from another version.
+        Parameters:
+            base (const char *): Start of the image; must stay valid for the lifetime of the tree.
+            size (size_t): Size of the image in bytes.
+        */
+        if (size < sizeof(SnapshotHeader))
+        {
+            return false;
+        }
+        const SnapshotHeader *head = (const SnapshotHeader *)base;
+        if (memcmp(head->magic, SNAPSHOT_MAGIC, sizeof(head->magic)) != 0 ||
+            head->version != SNAPSHOT_VERSION || head->totalSize > size || head->nodeCount == 0)
+        {
+            return false;
+        }
+
+        auto fits = [head](uint64_t offset, uint64_t bytes) {
+            return offset % 8 == 0 && offset <= head->totalSize && bytes <= head->totalSize - offset;
+        };
+        if (!fits(head->nodesOffset, (uint64_t)head->nodeCount * sizeof(FlatNode)) ||
+            !fits(head->questionPlanesOffset, (uint64_t)head->questionCount * 2 * head->maskWords * sizeof(uint64_t)) ||
+            !fits(head->characterPlanesOffset,
+                  (uint64_t)head->maskWords * 64 * 2 * ((head->questionCount + 63) / 64) * sizeof(uint64_t)) ||
+            !fits(head->universeOffset, (uint64_t)head->maskWords * sizeof(uint64_t)) ||
+            !fits(head->textOffsetsOffset, ((uint64_t)head->questionCount + 1) * sizeof(uint32_t)) ||
+            !fits(head->questionIdsOffset, (uint64_t)head->questionCount * sizeof(int32_t)) ||
+            !fits(head->catalogIdsOffset, (uint64_t)head->catalogSize * sizeof(int32_t)) ||
+            !fits(head->catalogOffsetsOffset, (2 * (uint64_t)head->catalogSize + 1) * sizeof(uint32_t)))
+        {
+            return false;
+        }
+        const uint32_t *questionOffsets = (const uint32_t *)(base + head->textOffsetsOffset);
+        const uint32_t *catalogOffsets = (const uint32_t *)(base + head->catalogOffsetsOffset);
+        if (!fits(head->textOffset, questionOffsets[head->questionCount]) ||
+            !fits(head->catalogTextOffset, catalogOffsets[2 * head->catalogSize]))
+        {
+            return false;
+        }
+
+        header = head;
+        nodes = (const FlatNode *)(base + head->nodesOffset);
+        answers = AnswerMatrix((const uint64_t *)(base + head->questionPlanesOffset),
+                               (const uint64_t *)(base + head->characterPlanesOffset),
+                               head->questionCount, head->maskWords);
+        universe = (const uint64_t *)(base + head->universeOffset);
+        textOffsets = questionOffsets;
+        text = base + head->textOffset;
+        questionIds = (const int32_t *)(base + head->questionIdsOffset);
+
+        // The catalog is tiny next to the tree, so it is copied out into Character objects.
+        const int32_t *catalogIds = (const int32_t *)(base + head->catalogIdsOffset);
+        const char *catalogText = base + head->catalogTextOffset;
+        catalog = CharacterCatalog();
+        for (uint32_t index = 0; index < head->catalogSize; index++)
+        {
+            // Adding in index order gives every character back the index the tree refers to it by.
+            const uint32_t *slot = catalogOffsets + 2 * index;
+            catalog.add(Character(catalogIds[index],
+                                  string(catalogText + slot[0], slot[1] - slot[0]),
+                                  string(catalogText + slot[1], slot[2] - slot[1])));
+        }
+        return true;
+    }
+
+    bool loadSnapshot(const string &snapshotFilename, uint64_t checksum, const BuildOptions &options)
+    {
+        /*
+        Desc: Maps a snapshot file and uses it in place if it was built from the current CSVs and options.
+        returns:
+        (bool): True if the snapshot was usable.
+        Parameters:
+            snapshotFilename (const string &): The path to the snapshot file.
+            checksum (uint64_t): Checksum of the current CSVs.
+            options (const BuildOptions &): The options the tree should have been built with.
+        */
+        unique_ptr<MappedFile> file(new MappedFile(snapshotFilename));
+        if (!file->is_open())
+        {
+            return false;
+        }
+        string_view contents = file->view();
+        if (!attach(contents.data(), contents.size()) || header->sourceChecksum != checksum ||
+            header->criterion != (uint32_t)options.criterion || header->objective != (uint32_t)options.objective)
+        {
+            header = nullptr;
+            return false;
+        }
+        mapping = move(file);
+        return true;
+    }
+
+    QuestionBank copyBank(size_t characterSlots, size_t extraQuestions = 0) const
+    {
+        /*
+        Desc: Copies the questions and answers out of the image into a bank that can be modified.
+        returns:
+        (QuestionBank): Owned copy of the question bank.
+        Parameters:
+            characterSlots (size_t): Minimum number of character slots in the copy.
+            extraQuestions (size_t): Room for this many more questions, with every answer UNKNOWN.
+        */
+        QuestionBank bank;
+        for (size_t q = 0; q < header->questionCount; q++)
+        {
+            bank.questions.push_back(Question(questionIds[q], string(getQuestionText((int)q))));
+        }
+        bank.answers = AnswerMatrix(header->questionCount + extraQuestions, max(characterSlots, answers.characterSlots()));
+        for (size_t q = 0; q < header->questionCount; q++)
+        {
+            for (size_t c = 0; c < answers.characterSlots(); c++)
+            {
+                Membership value = answers.get((int)c, (int)q);
+                if (value != UNKNOWN)
+                {
+                    bank.answers.set((int)c, (int)q, value);
+                }
+            }
+        }
+        return bank;
+    }
+
+    QuestionTree(const vector<FlatNode> &flat, const QuestionBank &bank, const CharacterCatalog &characterCatalog,
+                 const Bitset &characters, const BuildOptions &options)
+    {
+        /*
+        Desc: Wraps an already flattened tree, such as an existing tree with some subtrees rebuilt. The tree
+              lives in memory and matches no source CSVs.
+        Parameters:
+            flat (const vector<FlatNode> &): The flattened tree.
+            bank (const QuestionBank &): The questions the nodes refer to, and their answers.
+            characterCatalog (const CharacterCatalog &): Every character.
+            characters (const Bitset &): Indices of all characters.
+            options (const BuildOptions &): The options the tree was built with.
+        */
+        pack(flat, bank, characterCatalog, characters, 0, options);
+        attach((const char *)image.data(), image.size() * sizeof(uint64_t));
+    }
+
+    BuildOptions recordedOptions() const
+    {
+        /*
+        Desc: Recovers the options the tree was built with, for rebuilding parts of it the same way.
+        returns:
+        (BuildOptions): The recorded criterion and objective, with defaults for the rest.
+        */
+        BuildOptions options;
+        options.criterion = (SplitCriterion)header->criterion;
+        options.objective = (TreeObjective)header->objective;
+        return options;
+    }
+
+    void findStaleSubtrees(const AnswerMatrix &bank, uint32_t index, const Bitset &remaining, int question,
+                           const BuildOptions &options, vector<pair<uint32_t, Bitset>> &stale,
+                           vector<bool> &visited) const
+    {
+        /*
+        Desc: Finds the subtrees a new question should be built into: nodes whose split it beats under the
+              tree's criterion, and ambiguous leaves it can still separate. Nothing below such a node is visited.
+        Parameters:
+            bank (const AnswerMatrix &): Answers including the new question's.
+            index (uint32_t): Node to examine.
+            remaining (const Bitset &): Characters that reach the node.
+            question (int): Index of the new question.
+            options (const BuildOptions &): The options the tree was built with.
+            stale (vector<pair<uint32_t, Bitset>> &): Receives the nodes to rebuild and their characters.
+            visited (vector<bool> &): Nodes already examined; shared subtrees are reached with the same set.
+        */
+        if (visited[index])
+        {
+            return;
+        }
+        visited[index] = true;
+
+        size_t words = bank.characterWords();
+        int total = (int)remaining.size();
+        int yes = (int)remaining.intersection(bank.characters(question, POSITIVE), words).size();
+        int no = (int)remaining.intersection(bank.characters(question, NEGATIVE), words).size();
+        bool separates = yes > 0 && no > 0;
+        const FlatNode &node = nodes[index];
+        if (node.isLeaf())
+        {
+            if (separates && (node.label == UNDIFFERENTIATED || node.label == NO_MORE_QUESTIONS))
+            {
+                stale.emplace_back(index, remaining);
+            }
+            return;
+        }
+
+        // Score the current split with the same counts as the new question: characters with a known answer
+        // on each side. The branches passed down also keep the UNKNOWN ones, which would count them twice.
+        int current_yes = (int)remaining.intersection(bank.characters(node.label, POSITIVE), words).size();
+        int current_no = (int)remaining.intersection(bank.characters(node.label, NEGATIVE), words).size();
+        if (separates && scoreSplit(options.criterion, yes, no, total) <
+                             scoreSplit(options.criterion, current_yes, current_no, total))
+        {
+            stale.emplace_back(index, remaining);
+            return;
+        }
+        Bitset yes_ids = bank.branch(remaining, node.label, true);
+        Bitset no_ids = bank.branch(remaining, node.label, false);
+        findStaleSubtrees(bank, node.yes, yes_ids, question, options, stale, visited);
+        findStaleSubtrees(bank, node.no, no_ids, question, options, stale, visited);
+    }
+
+public:
+    // Constructors
+    QuestionTree(const string &filename, const string &charactersFilename = "characters.csv",
+                 const BuildOptions &options = BuildOptions())
+    {
+        build(filename, charactersFilename, checksumFiles({filename, charactersFilename}), options);
+    }
+
+    QuestionTree(const QuestionBank &bank, const CharacterCatalog &characterCatalog,
+                 const BuildOptions &options = BuildOptions())
+    {
+        /*
+        Desc: Builds the tree from data already in memory, such as the output of readDataCSV.
+        Parameters:
+            bank (const QuestionBank &): The questions and their answers.
+            characterCatalog (const CharacterCatalog &): Every character.
+            options (const BuildOptions &): How to build the tree.
+        */
+        build(bank, characterCatalog, 0, options);
+    }
+
+    QuestionTree(const string &filename, const string &charactersFilename, const string &snapshotFilename,
+                 const BuildOptions &options = BuildOptions())
+    {
+        /*
+        Desc: Loads the tree from a snapshot file, or builds it from the CSVs and writes the snapshot if the file
+              is missing, unreadable or was built from different CSVs or options. Lazily built trees are not
+              written, since most of their nodes do not exist yet.
+        Parameters:
+            filename (const string &): The path to the questions CSV file.
+            charactersFilename (const string &): The path to the characters CSV file.
+            snapshotFilename (const string &): The path to the snapshot file.
+            options (const BuildOptions &): How to build the tree if the snapshot cannot be used.
+        */
+        uint64_t checksum = checksumFiles({filename, charactersFilename});
+        if (!loadSnapshot(snapshotFilename, checksum, options))
+        {
+            build(filename, charactersFilename, checksum, options);
+            if (!options.lazy && !saveSnapshot(snapshotFilename))
+            {
+                cerr << "Error writing snapshot: " << snapshotFilename << endl;
+            }
+        }
+    }
+
+    // The accessors point into the tree's own image, so copies would dangle.
+    QuestionTree(const QuestionTree &) = delete;
+    QuestionTree &operator=(const QuestionTree &) = delete;
+
+    QuestionBank getBank() const
+    {
+        /*
+        Desc: Copies the questions and answers the tree was built from, for building a corrected tree.
+        returns:
+        (QuestionBank): Owned copy of the question bank, with a slot for every catalog index.
+        */
+        return copyBank(catalog.size());
+    }
+
+    bool saveSnapshot(const string &snapshotFilename) const
+    {
+        /*
+        Desc: Writes the tree's snapshot image to a file that later runs can map instead of rebuilding. The image
+              goes to a temporary file in the same directory that is then renamed over the target, so trees that
+              have the old file mapped, in this process or another, keep reading the old inode.
+        returns:
+        (bool): True if the whole snapshot was written; always false for a lazily built tree.
+        Parameters:
+            snapshotFilename (const string &): The path to write to.
+        */
+        if (lazy)
+        {
+            return false;
+        }
+        static atomic<unsigned> saves(0);
+        string temporary = snapshotFilename + ".tmp" + to_string(getpid()) + "." + to_string(saves++);
+        {
+            ofstream file(temporary, ios::binary | ios::trunc);
+            file.write((const char *)header, (streamsize)header->totalSize);
+            file.close();
+            if (!file)
+            {
+                remove(temporary.c_str());
+                return false;
+            }
+        }
+        if (rename(temporary.c_str(), snapshotFilename.c_str()) != 0)
+        {
+            remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    unique_ptr<QuestionTree> addCharacter(const Character &character, const vector<Membership> &characterAnswers,
+                                          size_t *changed = nullptr) const
+    {
+        /*
+        Desc: Builds a copy of the tree with a new character, without rebuilding the whole tree. The character's
+              answers are followed to the leaves they reach (both branches where the answer is UNKNOWN), and only
+              those leaves are rebuilt as subtrees over their characters plus the new one; the rest of the tree
+              is reused as it is. This tree is left untouched, so Sessions playing on it are unaffected; the new
+              tree lives in memory and matches no source CSVs.
+        returns:
+        (unique_ptr<QuestionTree>): The tree with the character added.
+        Parameters:
+            character (const Character &): The new character; its ID must not be in use.
+            characterAnswers (const vector<Membership> &): Its answer to every question, by question index.
+            changed (size_t *): If not null, receives the number of nodes that changed: the replaced leaves plus
+                                the nodes added below them.
+        */
+        if (lazy)
+        {
+            throw runtime_error("Lazily built trees cannot be modified");
+        }
+        if (character.char_id < 1 || catalog.contains(character.char_id))
+        {
+            throw runtime_error("Character ID is invalid or already in use");
+        }
+        if (characterAnswers.size() != header->questionCount)
+        {
+            throw runtime_error("Expected one answer per question");
+        }
+
+        int index = (int)catalog.size();
+        QuestionBank bank = copyBank((size_t)index + 1);
+        for (size_t q = 0; q < characterAnswers.size(); q++)
+        {
+            if (characterAnswers[q] != UNKNOWN)
+            {
+                bank.answers.set(index, (int)q, characterAnswers[q]);
+            }
+        }
+        CharacterCatalog characterCatalog = catalog;
+        characterCatalog.add(character);
+        Bitset characters(universe, header->maskWords);
+        characters.insert(index);
+
+        // Follow the new character's answers to every leaf they reach, narrowing the set as a Session would.
+        // An UNKNOWN answer leads down both branches.
+        vector<FlatNode> flat(nodes, nodes + header->nodeCount);
+        vector<pair<uint32_t, Bitset>> leaves;
+        vector<pair<uint32_t, Bitset>> pending = {{0, characters}};
+        vector<bool> visited(flat.size(), false);
+        while (!pending.empty())
+        {
+            pair<uint32_t, Bitset> step = move(pending.back());
+            pending.pop_back();
+            if (visited[step.first])
+            {
+                continue; // Shared subtrees are reached with the same set
+            }
+            visited[step.first] = true;
+            const FlatNode &node = flat[step.first];
+            if (node.isLeaf())
+            {
+                leaves.push_back(move(step));
+                continue;
+            }
+            Membership answer = characterAnswers[node.label];
+            if (answer != NEGATIVE)
+            {
+                pending.emplace_back(node.yes, bank.answers.branch(step.second, node.label, true));
+            }
+            if (answer != POSITIVE)
+            {
+                pending.emplace_back(node.no, bank.answers.branch(step.second, node.label, false));
+            }
+        }
+
+        size_t changedNodes = 0;
+        BuildOptions options = recordedOptions();
+        TreeBuilder builder(bank.answers, options);
+        for (auto &leaf : leaves)
+        {
+            vector<FlatNode> subtree = builder.flatten(builder.buildTree(leaf.second));
+
+            // The subtree's root takes the leaf's place; the rest is appended with its links shifted to match.
+            uint32_t shift = (uint32_t)flat.size() - 1;
+            for (FlatNode &node : subtree)
+            {
+                node.yes = node.yes == FlatNode::NO_CHILD ? node.yes : node.yes + shift;
+                node.no = node.no == FlatNode::NO_CHILD ? node.no : node.no + shift;
+            }
+            flat[leaf.first] = subtree[0];
+            flat.insert(flat.end(), subtree.begin() + 1, subtree.end());
+            changedNodes += subtree.size();
+        }
+
+        if (changed)
+        {
+            *changed = changedNodes;
+        }
+        return unique_ptr<QuestionTree>(new QuestionTree(flat, bank, characterCatalog, characters, options));
+    }
+
+    unique_ptr<QuestionTree> addQuestion(const string &questionText,
+                                         const unordered_map<int, Membership> &questionAnswers,
+                                         size_t *changed = nullptr) const
+    {
+        /*
+        Desc: Builds a copy of the tree with a new question, re-optimizing only the subtrees where it matters:
+              those whose current split the new question beats, and leaves that were ambiguous and the new
+              question can separate. Everything else is reused. This tree is left untouched, so Sessions playing
+              on it are unaffected; the new tree lives in memory and matches no source CSVs.
+        returns:
+        (unique_ptr<QuestionTree>): The tree with the question added.
+        Parameters:
+            questionText (const string &): Text of the new question.
+            questionAnswers (const unordered_map<int, Membership> &): Characters' answers by character ID;
+                                                                    characters not listed answer UNKNOWN.
+            changed (size_t *): If not null, receives the number of nodes in the rebuilt subtrees.
+        */
+        if (lazy)
+        {
+            throw runtime_error("Lazily built trees cannot be modified");
+        }
+        int question = (int)header->questionCount;
+        QuestionBank bank = copyBank(catalog.size(), 1);
+        // The new question takes the next unused ID.
+        int id = 0;
+        for (const Question &q : bank.questions)
+        {
+            id = max(id, q.q_id + 1);
+        }
+        bank.questions.push_back(Question(id, questionText));
+        for (auto &answer : questionAnswers)
+        {
+            int index = catalog.indexOf(answer.first);
+            if (index >= 0 && answer.second != UNKNOWN)
+            {
+                bank.answers.set(index, question, answer.second);
+            }
+        }
+
+        BuildOptions options = recordedOptions();
+        Bitset characters(universe, header->maskWords);
+        vector<pair<uint32_t, Bitset>> stale;
+        vector<bool> visited(header->nodeCount, false);
+        findStaleSubtrees(bank.answers, 0, characters, question, options, stale, visited);
+
+        // Rebuild the stale subtrees over the new bank.
+        TreeBuilder builder(bank.answers, options);
+        vector<vector<FlatNode>> rebuilt;
+        unordered_map<uint32_t, int> replacement; // Old node index -> index into rebuilt
+        size_t changedNodes = 0;
+        for (auto &entry : stale)
+        {
+            rebuilt.push_back(builder.flatten(builder.buildTree(entry.second)));
+            replacement[entry.first] = (int)rebuilt.size() - 1;
+            changedNodes += rebuilt.back().size();
+        }
+
+        // Lay the old tree and the rebuilt subtrees out breadth-first again, dropping the replaced nodes.
+        // A source node is (-1, old index) or (subtree, index within it).
+        vector<FlatNode> flat;
+        vector<pair<int, uint32_t>> sources;
+        unordered_map<uint64_t, uint32_t> placed;
+        auto place = [&](int tree, uint32_t index) {
+            if (tree < 0)
+            {
+                auto found = replacement.find(index);
+                if (found != replacement.end())
+                {
+                    tree = found->second;
+                    index = 0;
+                }
+            }
+            uint64_t key = ((uint64_t)(uint32_t)(tree + 1) << 32) | index;
+            auto known = placed.find(key);
+            if (known != placed.end())
+            {
+                return known->second;
+            }
+            uint32_t at = (uint32_t)flat.size();
+            placed.emplace(key, at);
+            flat.push_back(tree < 0 ? nodes[index] : rebuilt[tree][index]);
+            sources.emplace_back(tree, index);
+            return at;
+        };
+        place(-1, 0);
+        for (size_t i = 0; i < flat.size(); i++)
+        {
+            if (!flat[i].isLeaf())
+            {
+                FlatNode node = flat[i];
+                node.yes = place(sources[i].first, node.yes);
+                node.no = place(sources[i].first, node.no);
+                flat[i] = node;
+            }
+        }
+
+        if (changed)
+        {
+            *changed = changedNodes;
+        }
+        return unique_ptr<QuestionTree>(new QuestionTree(flat, bank, catalog, characters, options));
+    }
+
+    const FlatNode &getNode(uint32_t index) const { return lazy ? lazy->get(index) : nodes[index]; }
+    size_t getNodeCount() const { return lazy ? lazy->size() : header->nodeCount; }
+
+    uint32_t getChild(uint32_t index, bool answer) const
+    {
+        /*
+        Desc: Steps from an internal node to one of its children. On a lazily built tree the child is built the
+              first time any game reaches it; it is safe to call from several threads at once.
+        returns:
+        (uint32_t): Index of the child.
+        Parameters:
+            index (uint32_t): An internal node of this tree.
+            answer (bool): True for the "yes" child.
+        */
+        if (lazy)
+        {
+            return lazy->child(index, answer);
+        }
+        return answer ? nodes[index].yes : nodes[index].no;
+    }
+    size_t getQuestionCount() const { return header->questionCount; }
+    Bitset getCharacters() const { return Bitset(universe, header->maskWords); }
+    const CharacterCatalog &getCatalog() const { return catalog; }
+    const AnswerMatrix &getAnswers() const { return answers; }
+    SplitCriterion getCriterion() const { return (SplitCriterion)header->criterion; }
+
+    int getQuestionId(int question) const { return questionIds[question]; }
+
+    string_view getQuestionText(int question) const
+    {
+        return string_view(text + textOffsets[question], textOffsets[question + 1] - textOffsets[question]);
+    }
+
+    string getNodeText(uint32_t index) const
+    {
+        /*
+        Desc: Produces the text shown for a node: the question for internal nodes, the outcome for leaves.
+        returns:
+        (string): The question or result text.
+        Parameters:
+            index (uint32_t): Index of a node of this tree.
+        */
+        const FlatNode &node = getNode(index);
+        if (!node.isLeaf())
+        {
+            return string(getQuestionText(node.label));
+        }
+        switch (node.label)
+        {
+        case NO_MATCH:
+            return "No character matches the given answers.";
+        case NO_MORE_QUESTIONS:
+            return "No more questions. Unable to identify.";
+        case UNDIFFERENTIATED:
+            return "Unable to further differentiate.";
+        default:
+            return "Character identified: " + to_string(catalog.at(node.label).char_id);
+        }
+    }
+};
+
+// A player's answer, from sure "yes" to sure "no".
+enum GradedAnswer
+{
+    YES,
+    PROBABLY,
+    DONT_KNOW,
+    PROBABLY_NOT,
+    NO
+};
+
+// How strongly each GradedAnswer leans towards "yes": the chance the player means "yes".
+const double ANSWER_BELIEF[] = {1.0, 0.75, 0.5, 0.25, 0.0};
+
+// A character the game could still be about, with its probability.
+struct Candidate
+{
+    const Character *character;     // The character, from the tree's catalog
+    double score;                   // Probability that it is the player's character, from 0 to 1
+};
+
+// One game in progress: a cursor into a shared QuestionTree plus the characters still possible. A "don't know"
+// answer leaves the tree, since no node asks a different question of the same characters; the game then picks
+// each question itself from the characters still possible.
+class Session
+{
+private:
+    const QuestionTree *tree;   // Shared, read-only tree this game walks
+    uint32_t node;              // Index of the current node in the tree, or OFF_TREE
+    Bitset characters;          // Indices of characters not yet ruled out; as wide as the answer matrix rows
+    Bitset skipped;             // Questions answered "don't know"
+    int question;               // Question being asked once off the tree, or -1 if none is left
+    vector<pair<int, GradedAnswer>> history;    // Every question answered and its answer, in order
+    vector<int> yes_counts;     // Scratch: remaining "yes" characters per question, once off the tree
+    vector<int> no_counts;      // Scratch: remaining "no" characters per question, once off the tree
+
+    static const uint32_t OFF_TREE = 0xFFFFFFFFu;
+
+    int nextQuestion() {
+        /*
+        Desc: Picks the question that best splits the remaining characters under the tree's criterion, the same
+              way the tree was built. Questions already answered do not split the remaining characters, so only
+              skipped ones need excluding.
+        returns:
+        (int): Question index, or -1 if no question that was not skipped separates the remaining characters.
+        */
+        const AnswerMatrix &answers = tree->getAnswers();
+        countSplits(answers, characters, yes_counts.data(), no_counts.data(), 0, answers.questionCount());
+        return bestSplit(tree->getCriterion(), skipped, yes_counts.data(), no_counts.data(), answers.questionCount(),
+                         (int)characters.size());
+    }
+
+public:
+    // Constructor
+    Session(const QuestionTree &t)
+        : tree(&t), node(0), characters(t.getCharacters()), question(-1)
+    {
+        skipped.words.assign(t.getAnswers().questionWords(), 0);
+        // No question is asked twice, so answers never reallocate.
+        history.reserve(t.getAnswers().questionCount());
+        yes_counts.resize(t.getAnswers().questionCount());
+        no_counts.resize(t.getAnswers().questionCount());
+    }
+
+    string getQuestionText() const {
+        /*
+        Desc: Retrieves the text of the current question.
+        returns:
+        (string): The text content of the current question.
+        */
+        if (node != OFF_TREE) {
+            return tree->getNodeText(node);
+        }
+        if (question >= 0) {
+            return string(tree->getQuestionText(question));
+        }
+        size_t remaining = characters.size();
+        if (remaining == 0) {
+            return "No character matches the given answers.";
+        }
+        if (remaining == 1) {
+            return "Character identified: " + to_string(tree->getCatalog().at(characters.first()).char_id);
+        }
+        return "Unable to further differentiate.";
+    }
+
+    const Character *getCharacter() const {
+        /*
+        Desc: Retrieves a character based on the current state of the characters set.
+        returns:
+        (const Character *): The Character if game is over, nullptr otherwise.
+        */
+        size_t remaining = characters.size();
+        if (remaining > 1) {
+            return nullptr;
+        }
+        else if (remaining < 1) {
+            return &tree->getCatalog().notFound();
+        }
+        else {
+            return &tree->getCatalog().at(characters.first());
+        }
+    }
+
+    vector<Candidate> getCandidates(size_t k) const {
+        /*
+        Desc: Lists up to k of the characters not yet ruled out. They are equally likely, so this takes the first
+              k set bits of the candidate mask, in catalog order, without looking at the rest.
+        returns:
+        (vector<Candidate>): Up to k characters, each scored 1 / the number remaining.
+        Parameters:
+            k (size_t): Maximum number of candidates to return.
+        */
+        vector<Candidate> result;
+        size_t remaining = characters.size();
+        if (remaining == 0 || k == 0) {
+            return result;
+        }
+        result.reserve(min(k, remaining));
+        double score = 1.0 / remaining;
+        for (size_t w = 0; w < characters.words.size() && result.size() < k; w++) {
+            for (uint64_t bits = characters.words[w]; bits && result.size() < k; bits &= bits - 1) {
+                int index = (int)(w * 64 + __builtin_ctzll(bits));
+                result.push_back({&tree->getCatalog().at(index), score});
+            }
+        }
+        return result;
+    }
+
+    const vector<pair<int, GradedAnswer>> &getHistory() const { return history; }
+
+    void setAnswer(bool Answer){
+        /*
+        Desc: Updates the set of characters based on the answer provided and navigates the decision tree accordingly.
+        Parameters:
+            Answer (bool): The answer to the current question, where 'true' or 'false' affects character selection.
+        */
+        setAnswer(Answer ? YES : NO);
+    }
+
+    void setAnswer(GradedAnswer Answer){
+        /*
+        Desc: Updates the set of characters with a graded answer. "Probably" and "probably not" count as "yes"
+              and "no". "Don't know" rules nobody out and skips the question: the game leaves the tree and picks
+              its own questions from then on. Does not allocate.
+        Parameters:
+            Answer (GradedAnswer): The answer to the current question.
+        */
+        int current;
+        if (node != OFF_TREE) {
+            const FlatNode &at = tree->getNode(node);
+            if (at.isLeaf()) {
+                // Already at a result; nothing left to ask.
+                return;
+            }
+            current = at.label;
+        }
+        else if (question >= 0) {
+            current = question;
+        }
+        else {
+            return;
+        }
+        history.emplace_back(current, Answer);
+
+        if (Answer == DONT_KNOW) {
+            skipped.insert(current);
+            node = OFF_TREE;
+            question = nextQuestion();
+            return;
+        }
+
+        // The characters who would have answered the other way are ruled out, in place.
+        bool yes = ANSWER_BELIEF[Answer] > 0.5;
+        const AnswerMatrix &answers = tree->getAnswers();
+        characters.subtract(answers.characters(current, yes ? NEGATIVE : POSITIVE), answers.characterWords());
+        if (node != OFF_TREE) {
+            node = tree->getChild(node, yes);
+        }
+        else {
+            question = nextQuestion();
+        }
+    }
+};
+
+// How a BayesianSession picks its next question.
+enum QuestionSelection
+{
+    FOLLOW_TREE,        // The tree's question while the answers lead through it, then ones separating the top two
+    MOST_INFORMATIVE    // The unasked question whose answer says the most about the character, given the answers so far
+};
+
+// Options for a BayesianSession.
+struct BayesianOptions
+{
+    double error_rate = 0.05;                   // Chance a player gives the opposite of a character's known answer
+    double confidence_threshold = 0.95;         // Probability at which the top character is guessed
+    QuestionSelection selection = FOLLOW_TREE;  // How questions are picked
+};
+
+// One game in progress that never rules a character out. Every character keeps a log-probability that each answer
+// updates with the chance of a player answering that way by mistake, so a wrong answer costs a few questions
+// instead of the game. The game guesses once the most likely character is likely enough.
+class BayesianSession
+{
+private:
+    const QuestionTree *tree;   // Shared, read-only tree; its questions are asked while the answers follow it
+    uint32_t node;              // Index of the current node in the tree
+    vector<double> log_prob;    // Unnormalized log-probability of each character slot; -INFINITY if not playable
+    Bitset asked;               // Questions already asked; as wide as the answer matrix's question rows
+    double gains[5][2];         // Per GradedAnswer: log-likelihood of "yes" and "no" characters, less log(1/2)
+    BayesianOptions options;    // Error rate, confidence threshold and question selection
+    double binary_entropy;      // Entropy of an answer whose correct value is known: H(error rate)
+    vector<uint64_t> weights;   // Bit-planes of each character's quantized probability; plane k holds bit k
+    int question;               // Question being asked, or -1 once the game has guessed
+    int top;                    // Index of the most likely character, or -1 if there are none
+    int runner_up;              // Index of the second most likely character, or -1
+    double confidence;          // Probability of the top character
+    vector<pair<int, GradedAnswer>> history;    // Every question answered and its answer, in order
+
+    static const int WEIGHT_BITS = 12;  // Precision of the quantized probabilities used to score questions
+
+    void rank() {
+        /*
+        Desc: Finds the two most likely characters and the top one's probability.
+        */
+        top = -1;
+        runner_up = -1;
+        for (int c = 0; c < (int)log_prob.size(); c++) {
+            if (log_prob[c] == -INFINITY) {
+                continue;
+            }
+            if (top < 0 || log_prob[c] > log_prob[top]) {
+                runner_up = top;
+                top = c;
+            }
+            else if (runner_up < 0 || log_prob[c] > log_prob[runner_up]) {
+                runner_up = c;
+            }
+        }
+        if (top < 0) {
+            confidence = 0;
+            return;
+        }
+        double total = 0;
+        for (double l : log_prob) {
+            total += exp(l - log_prob[top]); // exp(-INFINITY) is 0
+        }
+        confidence = 1.0 / total;
+
+        if (options.selection == MOST_INFORMATIVE) {
+            // Quantize each probability relative to the top character's and store it as bit-planes, so the
+            // probability mass of any set of characters is a few popcounts per word.
+            size_t words = tree->getAnswers().characterWords();
+            fill(weights.begin(), weights.end(), 0);
+            double scale = (1 << WEIGHT_BITS) - 1;
+            for (size_t c = 0; c < log_prob.size(); c++) {
+                uint64_t weight = (uint64_t)llround(exp(log_prob[c] - log_prob[top]) * scale);
+                for (int k = 0; k < WEIGHT_BITS; k++) {
+                    weights[k * words + (c >> 6)] |= ((weight >> k) & 1) << (c & 63);
+                }
+            }
+        }
+    }
+
+    void masses(int q, uint64_t &yes, uint64_t &no) const {
+        /*
+        Desc: Sums the quantized probabilities of the characters answering a question each way, with weighted
+              popcounts over the planes.
+        Parameters:
+            q (int): Question index.
+            yes (uint64_t &): Receives the mass of the "yes" characters, in units of the top character's
+                              probability / (2^WEIGHT_BITS - 1).
+            no (uint64_t &): Receives the mass of the "no" characters.
+        */
+        const AnswerMatrix &answers = tree->getAnswers();
+        size_t words = answers.characterWords();
+        const uint64_t *yes_set = answers.characters(q, POSITIVE);
+        const uint64_t *no_set = answers.characters(q, NEGATIVE);
+        yes = 0;
+        no = 0;
+        for (int k = 0; k < WEIGHT_BITS; k++) {
+            const uint64_t *plane = weights.data() + k * words;
+            uint64_t yes_count = 0, no_count = 0;
+            for (size_t w = 0; w < words; w++) {
+                yes_count += __builtin_popcountll(plane[w] & yes_set[w]);
+                no_count += __builtin_popcountll(plane[w] & no_set[w]);
+            }
+            yes += yes_count << k;
+            no += no_count << k;
+        }
+    }
+
+    int mostInformativeQuestion() const {
+        /*
+        Desc: Scores every unasked question by the information its answer carries about the character, given
+              the current probabilities and the error rate: H(answer) - H(answer | character), where a character
+              with a known answer gives it with entropy H(error rate) and one with an unknown answer with 1 bit.
+        returns:
+        (int): Question index, or -1 if no unasked question carries any information.
+        */
+        const AnswerMatrix &answers = tree->getAnswers();
+        size_t words = answers.characterWords();
+        double total = 0;
+        for (int k = 0; k < WEIGHT_BITS; k++) {
+            for (size_t w = 0; w < words; w++) {
+                total += (double)((uint64_t)__builtin_popcountll(weights[k * words + w]) << k);
+            }
+        }
+        auto entropy = [](double p) {
+            return p <= 0 || p >= 1 ? 0.0 : -(p * log2(p) + (1 - p) * log2(1 - p));
+        };
+
+        int best = -1;
+        double best_gain = 1e-9;
+        double e = options.error_rate;
+        for (int q = 0; q < (int)answers.questionCount(); q++) {
+            if (asked.contains(q)) {
+                continue;
+            }
+            uint64_t yes_mass, no_mass;
+            masses(q, yes_mass, no_mass);
+            double yes = yes_mass / total;
+            double no = no_mass / total;
+            double unknown = max(0.0, 1 - yes - no);
+            double p_yes = yes * (1 - e) + no * e + unknown * 0.5;
+            double gain = entropy(p_yes) - (yes + no) * binary_entropy - unknown;
+            if (gain > best_gain) {
+                best_gain = gain;
+                best = q;
+            }
+        }
+        return best;
+    }
+
+    int chooseQuestion() {
+        /*
+        Desc: Picks the next question. With FOLLOW_TREE: the tree's question while the answers still lead through
+              it, then one that separates the two most likely characters, then any that checks the most likely
+              one. With MOST_INFORMATIVE: the most informative unasked question.
+        returns:
+        (int): Question index, or -1 if no unasked question would help.
+        */
+        if (options.selection == MOST_INFORMATIVE) {
+            return top < 0 ? -1 : mostInformativeQuestion();
+        }
+        const AnswerMatrix &answers = tree->getAnswers();
+        const FlatNode &current = tree->getNode(node);
+        if (!current.isLeaf() && !asked.contains(current.label)) {
+            return current.label;
+        }
+        if (top < 0) {
+            return -1;
+        }
+        size_t words = answers.questionWords();
+        const uint64_t *top_yes = answers.questions(top, POSITIVE);
+        const uint64_t *top_no = answers.questions(top, NEGATIVE);
+        if (runner_up >= 0) {
+            const uint64_t *other_yes = answers.questions(runner_up, POSITIVE);
+            const uint64_t *other_no = answers.questions(runner_up, NEGATIVE);
+            for (size_t w = 0; w < words; w++) {
+                uint64_t differ = ((top_yes[w] & other_no[w]) | (top_no[w] & other_yes[w])) & ~asked.words[w];
+                if (differ) {
+                    return (int)(w * 64 + __builtin_ctzll(differ));
+                }
+            }
+        }
+        for (size_t w = 0; w < words; w++) {
+            uint64_t known = (top_yes[w] | top_no[w]) & ~asked.words[w];
+            if (known) {
+                return (int)(w * 64 + __builtin_ctzll(known));
+            }
+        }
+        return -1;
+    }
+
+public:
+    // Constructor
+    BayesianSession(const QuestionTree &t, const BayesianOptions &opts = BayesianOptions())
+        : tree(&t), node(0), options(opts), question(-1)
+    {
+        /*
+        Desc: Starts a game with every character equally likely.
+        Parameters:
+            t (const QuestionTree &): The shared tree, for its questions, answers and characters.
+            opts (const BayesianOptions &): Error rate, in (0, 0.5), confidence threshold and question selection.
+        */
+        double e = options.error_rate;
+        if (!(e > 0 && e < 0.5)) {
+            throw runtime_error("Error rate must be between 0 and 0.5");
+        }
+        for (int a = YES; a <= NO; a++) {
+            // The player means "yes" with probability b, and says the opposite of what they mean with probability e.
+            double b = ANSWER_BELIEF[a];
+            gains[a][0] = log(b * (1 - e) + (1 - b) * e) - log(0.5);
+            gains[a][1] = log(b * e + (1 - b) * (1 - e)) - log(0.5);
+        }
+        binary_entropy = -(e * log2(e) + (1 - e) * log2(1 - e));
+
+        const AnswerMatrix &answers = t.getAnswers();
+        if (options.selection == MOST_INFORMATIVE) {
+            weights.assign(WEIGHT_BITS * answers.characterWords(), 0);
+        }
+        log_prob.assign(answers.characterSlots(), -INFINITY);
+        Bitset characters = t.getCharacters();
+        for (int c = 0; c < (int)log_prob.size(); c++) {
+            if (characters.contains(c)) {
+                log_prob[c] = 0;
+            }
+        }
+        asked.words.assign(answers.questionWords(), 0);
+        history.reserve(answers.questionCount());
+        rank();
+        question = confidence >= options.confidence_threshold ? -1 : chooseQuestion();
+    }
+
+    string getQuestionText() const {
+        /*
+        Desc: Retrieves the text of the current question, or the guess once the game has made one.
+        returns:
+        (string): The question or result text.
+        */
+        if (question >= 0) {
+            return string(tree->getQuestionText(question));
+        }
+        if (top < 0) {
+            return "No character matches the given answers.";
+        }
+        return "Character identified: " + to_string(tree->getCatalog().at(top).char_id);
+    }
+
+    const Character *getCharacter() const {
+        /*
+        Desc: Retrieves the guessed character.
+        returns:
+        (const Character *): The most likely character once it is likely enough or the questions have run out,
+                             nullptr before that.
+        */
+        if (question >= 0) {
+            return nullptr;
+        }
+        if (top < 0) {
+            return &tree->getCatalog().notFound();
+        }
+        return &tree->getCatalog().at(top);
+    }
+
+    double getConfidence() const { return confidence; }
+
+    vector<Candidate> getCandidates(size_t k) const {
+        /*
+        Desc: Lists the k most likely characters, most likely first. Selects them with nth_element and sorts only
+              those k, so a preview costs one pass over the probabilities rather than a full sort.
+        returns:
+        (vector<Candidate>): Up to k characters with their probabilities; ties in catalog order.
+        Parameters:
+            k (size_t): Maximum number of candidates to return.
+        */
+        vector<pair<double, int>> scored;
+        scored.reserve(log_prob.size());
+        for (int c = 0; c < (int)log_prob.size(); c++) {
+            if (log_prob[c] != -INFINITY) {
+                scored.emplace_back(log_prob[c], c);
+            }
+        }
+        k = min(k, scored.size());
+        auto more_likely = [](const pair<double, int> &a, const pair<double, int> &b) {
+            return a.first > b.first || (a.first == b.first && a.second < b.second);
+        };
+        if (k < scored.size()) {
+            nth_element(scored.begin(), scored.begin() + k, scored.end(), more_likely);
+        }
+        sort(scored.begin(), scored.begin() + k, more_likely);
+
+        // rank() left the top character's probability in confidence; the others are relative to it.
+        vector<Candidate> result;
+        result.reserve(k);
+        for (size_t i = 0; i < k; i++) {
+            double score = exp(scored[i].first - log_prob[top]) * confidence;
+            result.push_back({&tree->getCatalog().at(scored[i].second), score});
+        }
+        return result;
+    }
+
+    const vector<pair<int, GradedAnswer>> &getHistory() const { return history; }
+
+    void setAnswer(bool Answer){
+        /*
+        Desc: Updates every character's log-probability with a yes/no answer.
+        Parameters:
+            Answer (bool): The answer to the current question.
+        */
+        setAnswer(Answer ? YES : NO);
+    }
+
+    void setAnswer(GradedAnswer Answer){
+        /*
+        Desc: Updates every character's log-probability with the answer in one branch-free pass over the
+              question's row of the answer matrix, then picks the next question or guesses. "Don't know" changes
+              no probabilities and only moves on. Does not allocate.
+        Parameters:
+            Answer (GradedAnswer): The answer to the current question.
+        */
+        if (question < 0) {
+            // Already guessed; nothing left to ask.
+            return;
+        }
+        history.emplace_back(question, Answer);
+
+        // A character with a known answer gains the log-likelihood of the player's answer given it; one with
+        // no known answer is as likely to get either, log(1/2). Only the differences matter, so the latter is 0.
+        if (Answer != DONT_KNOW) {
+            const AnswerMatrix &answers = tree->getAnswers();
+            const uint64_t *yes_set = answers.characters(question, POSITIVE);
+            const uint64_t *no_set = answers.characters(question, NEGATIVE);
+            double yes_gain = gains[Answer][0];
+            double no_gain = gains[Answer][1];
+            double *values = log_prob.data();
+            for (size_t c = 0; c < log_prob.size(); c++) {
+                uint64_t is_yes = (yes_set[c >> 6] >> (c & 63)) & 1;
+                uint64_t is_no = (no_set[c >> 6] >> (c & 63)) & 1;
+                values[c] += is_yes * yes_gain + is_no * no_gain;
+            }
+        }
+
+        asked.insert(question);
+        const FlatNode &current = tree->getNode(node);
+        if (Answer != DONT_KNOW && !current.isLeaf() && current.label == question) {
+            node = tree->getChild(node, ANSWER_BELIEF[Answer] > 0.5);
+        }
+        rank();
+        question = confidence >= options.confidence_threshold ? -1 : chooseQuestion();
+    }
+};
+
+// Settings for FeedbackLog.
+struct FeedbackOptions
+{
+    double prior_weight = 8;    // How many player answers the data's own answer is worth
+    double agreement = 0.8;     // Probability of "yes" (or "no") a corrected answer needs; anything between is unknown
+    size_t shards = 8;          // Copies of the counters; threads spread over them so popular characters don't contend
+};
+
+// Answers players gave in finished games, counted by character and question, for correcting the answer matrix.
+// record() may be called from any number of threads at once; fold() and rebuild() may run alongside it, and see
+// each answer either wholly or not at all.
+class FeedbackLog
+{
+private:
+    QuestionBank prior;                 // The questions and the data's answers that player answers are weighed against
+    CharacterCatalog catalog;           // Maps confirmed character IDs to indices
+    FeedbackOptions options;            // Prior weight, agreement and shard count
+    size_t cells;                       // Counters per shard: one per (character, question)
+    vector<unique_ptr<atomic<uint64_t>[]>> shards;  // [shard][character][question], "yes" quarters in the low
+                                                    // half and "no" quarters in the high half
+
+    static const uint32_t QUARTERS = 4; // Counter units per answer, so "probably" can count 3/4 towards "yes"
+
+    atomic<uint64_t> &counter(int character, int question) const
+    {
+        /*
+        Desc: Locates the counter of a character and question in the calling thread's shard.
+        returns:
+        (atomic<uint64_t> &): Both halves of the character's answers to the question, so one fetch_add records
+                              an answer whole.
+        Parameters:
+            character (int): Character index.
+            question (int): Question index.
+        */
+        size_t shard = hash<thread::id>()(this_thread::get_id()) % shards.size();
+        return shards[shard][(size_t)character * prior.questions.size() + question];
+    }
+
+    double estimate(int character, int question) const
+    {
+        /*
+        Desc: Sums a character's answers to a question over every shard and weighs them against the data's answer.
+        returns:
+        (double): The probability of "yes", from 0 to 1.
+        Parameters:
+            character (int): Character index.
+            question (int): Question index.
+        */
+        size_t cell = (size_t)character * prior.questions.size() + question;
+        uint64_t yes_quarters = 0, no_quarters = 0;
+        for (const auto &shard : shards)
+        {
+            uint64_t both = shard[cell].load(memory_order_relaxed);
+            yes_quarters += both & 0xFFFFFFFFu;
+            no_quarters += both >> 32;
+        }
+        double yes = (double)yes_quarters / QUARTERS;
+        double no = (double)no_quarters / QUARTERS;
+        Membership known = prior.answers.get(character, question);
+        double prior_yes = known == POSITIVE ? 1 : known == NEGATIVE ? 0 : 0.5;
+        double weight = options.prior_weight + yes + no;
+        return weight > 0 ? (options.prior_weight * prior_yes + yes) / weight : 0.5;
+    }
+
+public:
+    // Constructor
+    FeedbackLog(const QuestionTree &tree, const FeedbackOptions &opts = FeedbackOptions())
+        : prior(tree.getBank()), catalog(tree.getCatalog()), options(opts)
+    {
+        /*
+        Desc: Starts an empty log for the tree's characters and questions. Trees rebuilt from the log keep the
+              same characters and questions, so games on them can keep recording into it.
+        Parameters:
+            tree (const QuestionTree &): The tree whose answers the feedback corrects.
+            opts (const FeedbackOptions &): Prior weight, agreement and shard count.
+        */
+        if (options.shards == 0 || !(options.agreement > 0.5 && options.agreement <= 1) || options.prior_weight < 0)
+        {
+            throw runtime_error("Invalid feedback options");
+        }
+        cells = catalog.size() * prior.questions.size();
+        for (size_t s = 0; s < options.shards; s++)
+        {
+            shards.emplace_back(new atomic<uint64_t>[cells]);
+            for (size_t c = 0; c < cells; c++)
+            {
+                shards.back()[c].store(0, memory_order_relaxed);
+            }
+        }
+    }
+
+    void record(int characterId, const vector<pair<int, GradedAnswer>> &answers)
+    {
+        /*
+        Desc: Counts the answers of a finished game towards the character the player confirmed. "Don't know"
+              answers are not counted. Does not allocate or lock.
+        Parameters:
+            characterId (int): ID of the character the player was thinking of.
+            answers (const vector<pair<int, GradedAnswer>> &): Each question asked and its answer, as given by a
+                                                               session's getHistory().
+        */
+        int character = catalog.indexOf(characterId);
+        if (character < 0)
+        {
+            throw runtime_error("Character with the given ID not found");
+        }
+        for (const auto &answer : answers)
+        {
+            if (answer.first < 0 || answer.first >= (int)prior.questions.size() || answer.second == DONT_KNOW)
+            {
+                continue;
+            }
+            uint64_t yes = (uint64_t)(ANSWER_BELIEF[answer.second] * QUARTERS);
+            counter(character, answer.first).fetch_add(yes | (QUARTERS - yes) << 32, memory_order_relaxed);
+        }
+    }
+
+    double probability(int characterId, int question) const
+    {
+        /*
+        Desc: Estimates how likely players are to answer "yes" about a character: the data's answer counts as
+              prior_weight answers (half each way if unknown), and every recorded answer is added to it.
+        returns:
+        (double): The probability of "yes", from 0 to 1.
+        Parameters:
+            characterId (int): A character ID.
+            question (int): Question index.
+        */
+        int character = catalog.indexOf(characterId);
+        if (character < 0)
+        {
+            throw runtime_error("Character with the given ID not found");
+        }
+        return estimate(character, question);
+    }
+
+    QuestionBank fold() const
+    {
+        /*
+        Desc: Turns the answer probabilities back into a question bank: "yes" if players agree on it at least as
+              often as the agreement setting asks, "no" likewise, and unknown if they are split.
+        returns:
+        (QuestionBank): The corrected questions and answers, indexed like the original tree's.
+        */
+        QuestionBank bank;
+        bank.questions = prior.questions;
+        bank.answers = AnswerMatrix(prior.questions.size(), prior.answers.characterSlots());
+        for (size_t c = 0; c < catalog.size(); c++)
+        {
+            for (size_t q = 0; q < prior.questions.size(); q++)
+            {
+                double p = estimate((int)c, (int)q);
+                if (p >= options.agreement)
+                {
+                    bank.answers.set((int)c, (int)q, POSITIVE);
+                }
+                else if (1 - p >= options.agreement)
+                {
+                    bank.answers.set((int)c, (int)q, NEGATIVE);
+                }
+            }
+        }
+        return bank;
+    }
+
+    unique_ptr<QuestionTree> rebuild(const BuildOptions &buildOptions = BuildOptions()) const
+    {
+        /*
+        Desc: Builds a new tree from the corrected answers. Meant to be run periodically, off the request path;
+              games in progress keep the tree they started on.
+        returns:
+        (unique_ptr<QuestionTree>): The new tree.
+        Parameters:
+            buildOptions (const BuildOptions &): How to build the tree.
+        */
+        return make_unique<QuestionTree>(fold(), catalog, buildOptions);
     }
 };
\ No newline at end of file